@@ -1,10 +1,12 @@
 #pragma once
 
+#include "core/device/serial_io_service.h"
 #include "vex_thread.h"
 #include "v5.h"
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <stdio.h>
 
@@ -15,12 +17,35 @@ class COBSSerialDevice {
     // Cobs Encoded packet containing 0 delimeters ready to be sent over the wire
     using WirePacket = std::vector<uint8_t>;
 
+    /// Bytes pulled from VEX OS per vexGenericSerialReceive call
+    static constexpr size_t RX_CHUNK_SIZE = 256;
+    /// Number of packets held at once, the one being assembled and the last RX_SLOT_COUNT - 1 decoded
+    static constexpr size_t RX_SLOT_COUNT = 4;
+    /// Bytes reserved per slot up front. Bigger packets still work, the slot just grows once
+    static constexpr size_t RX_SLOT_RESERVE = 256;
+
+    /**
+     * A decoded packet still sitting in the device's receive slot, not a copy.
+     * Its slot is reused once RX_SLOT_COUNT - 1 more packets have been decoded, so
+     * a consumer has to be done with it (or copy it) by then.
+     */
+    struct PacketView {
+        const uint8_t *data;
+        size_t size;
+
+        const uint8_t *begin() const { return data; }
+        const uint8_t *end() const { return data + size; }
+        uint8_t operator[](size_t i) const { return data[i]; }
+    };
+
     /**
      * Create a serial device that communicates with 0-delimeted COBS encoded packets
      * @param port the vex::PORTXX that the device was created on
      * @param baud the baud rate to run the port at (i.e. 115200)
+     * @param expected_packet_hz roughly how often the other end sends, sets how often the port is checked while
+     * data is flowing
      */
-    COBSSerialDevice(int32_t port, int32_t baud);
+    COBSSerialDevice(int32_t port, int32_t baud, uint32_t expected_packet_hz = 100);
     /**
      * Send a packet of data to the wire. This function takes care of the encoding and sending
      * Blocks until the entire packet is written
@@ -56,13 +81,28 @@ class COBSSerialDevice {
      * @param[out] out the buffer to write the data into
      */
     static void cobs_decode(const WirePacket &in, Packet &out);
+    /**
+     * Decode a cobs encoded packet over itself. The decoded data is never longer
+     * than the encoded data so no second buffer is needed
+     * @param[in,out] data the packet recieved from the wire (without delimeters), replaced by the decoded data
+     * @param len the number of encoded bytes
+     * @return the number of decoded bytes
+     */
+    static size_t cobs_decode_in_place(uint8_t *data, size_t len);
     /**
      * print hex data to the console
      * prints as 16 columns
      */
     static void hexdump(const uint8_t *data, size_t len);
 
+    /**
+     * @return a copy of the last decoded packet. Prefer last_packet() on hot paths
+     */
     Packet get_last_decoded_packet();
+    /**
+     * @return the last decoded packet, without copying it out of its slot
+     */
+    PacketView last_packet() const;
 
   protected:
     /**
@@ -71,24 +111,54 @@ class COBSSerialDevice {
      */
     bool poll_incoming_data_once();
 
+    /**
+     * Sleep until the serial service sees bytes on the port or wake() is called
+     * @param timeout_ms the longest to sleep for
+     * @param self the calling task, suspended until woken if given. See SerialIOService::Listener::wait
+     * @return true if woken early, false on timeout
+     */
+    bool wait_for_data(uint32_t timeout_ms, vex::task *self = nullptr) { return rx_listener->wait(timeout_ms, self); }
+
+    /**
+     * Wake a task sleeping in wait_for_data(), e.g. because there is something to send
+     */
+    void wake() { rx_listener->notify(); }
+
     /// @brief  process one byte at a time
     /// @param byte the incoming byte
     /// @return true if a packet was decoded
     bool handle_incoming_byte(uint8_t byte);
 
+    /// @brief process a run of received bytes, stopping after the first packet that completes
+    /// @param data the incoming bytes
+    /// @param len how many bytes there are
+    /// @param[out] used how many bytes were consumed
+    /// @return true if a packet was decoded
+    bool handle_incoming_bytes(const uint8_t *data, size_t len, size_t &used);
+
   private:
     vex::mutex serial_access_mut;
     int32_t port;
+    SerialIOService::Listener *rx_listener;
 
     // Buffer to hold data about to be written
     Packet writing_buffer;
     // Buffer to hold encoded cobs data about to be written
     WirePacket encoded_write;
 
-    // buffer used to get data from VEX OS land to userland. Scratch space
-    std::vector<uint8_t> incoming_buffer;
-    // buffer to read bytes in when building up a cobs packet
-    WirePacket incoming_wire_packet;
-    // contains the last packet that was received and decoded
-    Packet last_decoded_packet;
+    /// @brief decode the assembling slot and move on to the next one
+    /// @return true if the slot held a packet, false if it was just repeated delimeters
+    bool finish_incoming_packet();
+
+    // buffer used to get data from VEX OS land to userland, drained before it is refilled
+    uint8_t incoming_buffer[RX_CHUNK_SIZE];
+    size_t incoming_head = 0;
+    size_t incoming_len = 0;
+
+    // Encoded bytes are gathered in a slot and decoded in place. The slot
+    // being assembled is rx_slots[assembling_slot], the newest decoded packet
+    // is in the one before it
+    std::vector<uint8_t> rx_slots[RX_SLOT_COUNT];
+    size_t assembling_slot = 0;
+    bool have_decoded_packet = false;
 };
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "v5.h"
+#include "vex.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * One task that watches every generic serial port for incoming bytes, so the
+ * tasks reading those ports can sleep instead of spinning on
+ * vexGenericSerialReceiveAvail with yield() or short delays.
+ *
+ * Each reader gets a Listener for its port. The service polls a port at the
+ * reader's expected packet rate while bytes keep arriving, backs off towards
+ * the reader's max latency once the port has missed a few packets, and bumps the listener's
+ * event count whenever it sees bytes waiting. The reader blocks in
+ * Listener::wait() until that happens.
+ *
+ *   SerialIOService::Listener *rx = SerialIOService::instance().listen(port, 100);
+ *   while (true) {
+ *       while (read_packet()) { ... }
+ *       rx->wait(10, &reader_task);
+ *   }
+ *
+ * VEX OS has no semaphore, so a reader that passes its own task to wait() is
+ * suspended, and resumed by notify() or by the service once bytes arrive or its
+ * timeout is up. It isn't run at all in between. A reader without a task handle
+ * falls back to sleeping one poll interval at a time.
+ */
+class SerialIOService {
+  public:
+    /// More listeners than this are not polled, their wait() only times out or gets notified
+    static constexpr size_t MAX_LISTENERS = 24;
+    /// Longest a quiet port goes without being polled unless the listener asks for less
+    static constexpr uint32_t DEFAULT_MAX_LATENCY_MS = 20;
+    /// Bytes waiting in VEX OS past which the port is polled every ms no matter the packet rate
+    static constexpr int32_t RX_HIGH_WATER = 256;
+
+    /**
+     * The reading side of one port
+     */
+    class Listener {
+      public:
+        /**
+         * Blocks until bytes have been seen on the port (or notify() was
+         * called) since the last wait() returned, or until the timeout passes.
+         * @param timeout_ms the longest to block for
+         * @param self the task calling wait(). It is suspended until woken, without it wait() sleeps in
+         * poll interval steps
+         * @return true if woken by an event, false on timeout
+         */
+        bool wait(uint32_t timeout_ms, vex::task *self = nullptr);
+
+        /**
+         * Wakes the reader from another task, e.g. because it has something to send
+         */
+        void notify();
+
+        int32_t get_port() const { return port; }
+
+      private:
+        friend class SerialIOService;
+        Listener(int32_t port, uint32_t active_interval_ms, uint32_t max_interval_ms);
+
+        int32_t port;
+        // how often the port is polled while bytes keep arriving, and while it is quiet at most
+        uint32_t active_interval_ms;
+        uint32_t max_interval_ms;
+        // only touched by the service task
+        uint32_t interval_ms;
+        uint32_t next_poll_ms;
+        uint32_t last_data_ms;
+
+        std::atomic<uint32_t> events;
+        uint32_t seen_events;
+
+        // set by the reader before it suspends itself, sleeping is published last
+        // false if the service had no room for this listener, nothing resumes it then
+        bool polled;
+        vex::task *sleeper;
+        uint32_t wake_at_ms;
+        uint32_t sleep_events;
+        std::atomic<bool> sleeping;
+    };
+
+    static SerialIOService &instance();
+
+    /**
+     * Starts watching a port
+     * @param port the port the reader receives on
+     * @param expected_packet_hz how often the device sends, sets the poll rate while data is flowing
+     * @param max_latency_ms the longest the first byte after a quiet period may go unnoticed
+     * @return the listener to wait on. It lives as long as the program
+     */
+    Listener *listen(int32_t port, uint32_t expected_packet_hz, uint32_t max_latency_ms = DEFAULT_MAX_LATENCY_MS);
+
+  private:
+    SerialIOService();
+
+    /// starts the task on the first wait(), listeners are usually made before the scheduler runs
+    void start();
+
+    static int service_thread(void *self);
+
+    /// polls the ports that are due and resumes readers whose event or timeout came
+    /// @return ms until the next port or reader timeout is due
+    uint32_t poll_once(uint32_t now_ms);
+
+    /// shortens the sleep for readers that went to sleep while poll_once ran
+    /// @return ms until the first of them times out, or sleep_ms
+    uint32_t trim_to_sleepers(uint32_t now_ms, uint32_t sleep_ms);
+
+    vex::mutex listen_mut;
+    Listener *listeners[MAX_LISTENERS];
+    std::atomic<size_t> num_listeners;
+
+    std::atomic<bool> started;
+    vex::task service_task;
+    // when the service task runs next, a reader timing out before that can't count on being resumed
+    std::atomic<uint32_t> next_pass_ms;
+};
@@ -39,6 +39,8 @@ void delay_ms(uint32_t ms);
 
 namespace VDP {
 constexpr size_t MAX_CHANNELS = 256;
+// most fixed size fields one channel can flatten to, the size of a delta packet's bitmask
+constexpr size_t MAX_CHANNEL_FIELDS = 256;
 
 class Part;
 // Shared Part Pointer to delete an object that has no pointer pointing to it
@@ -49,10 +51,49 @@ using Packet = std::vector<uint8_t>;
 
 // defines a channel id as an 8bit unsigned integer
 using ChannelID = uint8_t;
+enum class Type : uint8_t;
+class PacketReader;
+/**
+ * A channel's data message compiled down to a flat list of where each field's
+ * value lives and where it goes in the message. Sending a compiled channel is
+ * one memcpy per field into a buffer sized once, instead of a virtual
+ * write_message call down the Part tree.
+ * Only channels made of fixed size fields compile, anything with a String
+ * keeps going through the tree.
+ */
+struct ChannelLayout {
+    struct Field {
+        void *value;
+        size_t size;
+        size_t offset;
+        Type type;
+        // delta packets only resend the field once it moved further than this, 0 for any change
+        double epsilon;
+    };
+    std::vector<Field> fields;
+    // bytes of data in the message, not counting the header, id and checksum
+    size_t payload_size = 0;
+    // the Part tree this was compiled from, nullptr if not compiled
+    const Part *source = nullptr;
+
+    /**
+     * adds a fixed size field after the ones already added
+     * @param value where the field's value is stored
+     * @param size how many bytes the value is
+     * @param type the field's schema type
+     * @param epsilon smallest change worth resending in a delta packet
+     */
+    void add_field(void *value, size_t size, Type type, double epsilon);
+    /**
+     * forgets the compiled layout, the channel goes back to writing through its Part tree
+     */
+    void clear();
+};
 class Channel {
   public:
     template <typename MutexType> friend class RegistryListener;
     friend class RegistryController;
+    friend class PacketWriter;
     /**
      * Creates a channel used for sending data to the brain
      * @param data Part Pointer of data to be stored at the channel
@@ -63,6 +104,26 @@ class Channel {
      * @return The Channel ID from 0 - 256
      */
     ChannelID getID() const;
+    /**
+     * Compiles the channel's Part tree into a flat layout for sending.
+     * The layout points into the Parts, it is only used while data is still the Part it was compiled from
+     * @return true if every field is fixed size and the layout was compiled
+     */
+    bool compile_layout();
+    /**
+     * @return the compiled layout, check that its source is data before using it
+     */
+    const ChannelLayout &get_layout() const { return layout; }
+    /**
+     * Reads a delta data message into data, fields missing from the message keep their last value
+     * @param reader a reader positioned right after the channel id
+     * @return false if the channel can't be flattened or the message doesn't match its layout
+     */
+    bool read_delta_message(PacketReader &reader);
+    /**
+     * Makes the next delta send a full keyframe, e.g. because the last packet never made it out
+     */
+    void request_keyframe() { delta_sends_since_keyframe = DELTA_KEYFRAME_NOW; }
 
   private:
     /**
@@ -74,7 +135,16 @@ class Channel {
 
     ChannelID id = 0;
     Packet packet_scratch_space;
+    ChannelLayout layout;
     bool acked = false;
+    // negotiation retries, only touched by the controller
+    uint32_t broadcast_ms = 0;
+    uint8_t broadcast_tries = 0;
+
+    static constexpr uint32_t DELTA_KEYFRAME_NOW = 0xFFFFFFFF;
+    // every field as of the last delta or keyframe sent, laid out like the payload
+    std::vector<uint8_t> delta_last_sent;
+    uint32_t delta_sends_since_keyframe = DELTA_KEYFRAME_NOW;
     // std::vector
 };
 
@@ -105,7 +175,11 @@ enum class PacketFunction : uint8_t {
 struct PacketHeader {
     PacketType type;
     PacketFunction func;
+    // Data Send packets only: the payload is a changed-field bitmask and only the changed fields
+    bool delta;
 };
+// header bit marking a delta data packet, below the type and function bits
+constexpr uint8_t PACKET_DELTA_BIT_MASK = 0b00010000;
 enum PacketValidity : uint8_t {
     Ok,
     BadChecksum,
@@ -199,6 +273,13 @@ class Part {
 
     virtual void Visit(Visitor *) = 0;
 
+    /**
+     * adds this Part's data fields to a flat layout, see ChannelLayout
+     * @param layout the layout to add to
+     * @return false if the Part has no fixed size, the default
+     */
+    virtual bool add_to_layout(ChannelLayout &layout);
+
   protected:
     // These are needed to decode correctly but you shouldn't call them directly
     /**
@@ -228,24 +309,37 @@ class Part {
 };
 /*
  * Defines a PacketReader, it reads packets
+ * The reader borrows the bytes it reads, it does not copy the packet. The
+ * packet has to outlive the reader
  */
 class PacketReader {
   public:
     /**
-     * Defines a PacketReader to read a packet
+     * Defines a PacketReader to read a packet with a set start location for the packet
      * @param pac the packet to read
+     * @param start the start location for the reader to start reading from
      */
-    PacketReader(Packet pac);
+    explicit PacketReader(const Packet &pac, size_t start = 0);
     /**
-     * Defines a PacketReader to read a packet with a set start location for the packet
-     * @param pac the packet to read
+     * Defines a PacketReader to read raw bytes, e.g. straight out of a serial receive slot
+     * @param data the bytes to read
+     * @param size how many bytes there are
      * @param start the start location for the reader to start reading from
      */
-    PacketReader(Packet pac, size_t start);
+    PacketReader(const uint8_t *data, size_t size, size_t start = 0);
+    // A temporary packet would be gone before the reader is used
+    PacketReader(Packet &&pac, size_t start = 0) = delete;
     /**
-     * @return the current byte the reader is on
+     * @return the current byte the reader is on, 0 once past the end of the packet
      */
     uint8_t get_byte();
+    /**
+     * copies the next count bytes out of the packet
+     * @param out where to copy them
+     * @param count how many bytes to copy, nothing is copied if fewer than that are left
+     * @return false if fewer than count bytes were left
+     */
+    bool get_bytes(void *out, size_t count);
     /**
      * @return the type of the current byte the reader is on
      */
@@ -254,6 +348,10 @@ class PacketReader {
      * @return a string of bytes the reader is reading until the next 0 byte (end of the Packet)
      */
     std::string get_string();
+    /**
+     * @return how many bytes are left to read
+     */
+    size_t remaining() const { return read_head < len ? len - read_head : 0; }
 
     /**
      * @return the value stored by a Number Part
@@ -266,29 +364,33 @@ class PacketReader {
         );
         // checks that the size of the number its trying to read combined with its location
         // doesnt put it past the packet size
-        if (read_head + sizeof(Number) > pac.size()) {
+        if (read_head + sizeof(Number) > len) {
             printf(
               "%s:%d: Reading a number[%d] at position %d would read past "
               "buffer of "
               "size %d\n",
-              __FILE__, __LINE__, sizeof(Number), read_head, pac.size()
+              __FILE__, __LINE__, (int)sizeof(Number), (int)read_head, (int)len
             );
             return 0;
         }
         Number value = 0;
         // copies the the number at the reader head to the Number's stored value and
         // adds the size of the number to the read head so it moves on to the next set of bits
-        std::memcpy(&value, &pac[read_head], sizeof(Number));
+        std::memcpy(&value, data + read_head, sizeof(Number));
         read_head += sizeof(Number);
         return value;
     }
 
   private:
-    Packet pac;
+    const uint8_t *data;
+    size_t len;
     size_t read_head;
 };
 /**
  * Defines a PacketWriter, it writes packets
+ * It either appends to a Packet (reuse the same one and it stops allocating
+ * once it has grown to fit) or fills a fixed buffer the caller owns, which
+ * never allocates
  */
 class PacketWriter {
   public:
@@ -297,6 +399,12 @@ class PacketWriter {
      * @param scratch_space the packet for the writer to write to
      */
     explicit PacketWriter(Packet &scratch_space);
+    /**
+     * creates a packet writer over a fixed buffer
+     * @param buffer the buffer to write to
+     * @param capacity how many bytes fit in buffer. Writes past it are dropped and overflowed() is set
+     */
+    PacketWriter(uint8_t *buffer, size_t capacity);
     /**
      * clears the packet the writer is writing to
      */
@@ -304,12 +412,32 @@ class PacketWriter {
     /**
      * @return the size of the packet
      */
-    size_t size();
+    size_t size() const;
+    /**
+     * @return the bytes written so far
+     */
+    const uint8_t *data() const;
+    /**
+     * @return true if a fixed buffer ran out of room, the packet is incomplete
+     */
+    bool overflowed() const { return overflow; }
     /**
      * writes a byte to the end of the packet
      * @param b the byte to write
      */
     void write_byte(uint8_t b);
+    /**
+     * writes raw bytes to the end of the packet
+     * @param bytes the bytes to write
+     * @param count how many bytes to write
+     */
+    void write_bytes(const void *bytes, size_t count);
+    /**
+     * makes room for count bytes at the end of the packet to be filled in directly
+     * @param count how many bytes to make room for
+     * @return where to write them, nullptr if a fixed buffer is out of room
+     */
+    uint8_t *reserve(size_t count);
     /**
      * writes a VDP type to the packet in the form of a byte
      * @param t the VDP type to write to the packet
@@ -340,28 +468,40 @@ class PacketWriter {
      * @param chan the Channel to write the data from
      */
     void write_data_message(const Channel &part);
+    /**
+     * writes only the fields of a channel that changed since it was last sent, as
+     * [header|id|changed bitmask|changed values|crc]. Every keyframe_interval sends,
+     * or whenever the channel has no flat layout, a full data message is written instead
+     * @param chan the Channel to write the data from
+     * @param keyframe_interval how many delta messages may follow one full message
+     */
+    void write_delta_message(Channel &chan, uint32_t keyframe_interval);
     /**
      * writes a request for a channel schematic to the packets
      * @param chan the Channel to write the data from
      */
     void write_request();
     /**
-     * @return the packet the writer is writing to
+     * @return the packet the writer is writing to. Only for writers made over a Packet
      */
     const Packet &get_packet() const;
     /**
      * writes a number to the end of the packet
+     * numbers go out in the brain's native little endian order, so this is a single copy
      */
-    template <typename Number> void write_number(const Number &num) {
-        std::array<uint8_t, sizeof(Number)> bytes;
-        std::memcpy(&bytes, &num, sizeof(Number));
-        for (const uint8_t b : bytes) {
-            write_byte(b);
-        }
-    }
+    template <typename Number> void write_number(const Number &num) { write_bytes(&num, sizeof(Number)); }
 
   private:
-    Packet &sofar;
+    /**
+     * appends the CRC32 of everything written so far
+     */
+    void write_checksum();
+
+    Packet *sofar;
+    uint8_t *buffer;
+    size_t capacity;
+    size_t length;
+    bool overflow;
 };
 /**
  * defines a generic device to trasmit packets through
@@ -381,6 +521,14 @@ class AbstractDevice {
      * me when my ex-wife
      */
     virtual void register_receive_callback(std::function<void(const VDP::Packet &packet)> callback) = 0;
+    /**
+     * @return bytes per second the medium can carry, 0 if unknown. Scheduled channels are budgeted against it
+     */
+    virtual uint32_t link_bytes_per_second() const { return 0; }
+    /**
+     * @return packets handed to send_packet that haven't gone out yet, how far behind the medium is
+     */
+    virtual uint32_t send_backlog() const { return 0; }
     /**
      *  deleter for the device, used to delete it when it is no longer needed
      */
@@ -1,6 +1,7 @@
 #pragma once
 #include "core/device/vdb/protocol.hpp"
 #include "vex.h"
+#include <atomic>
 #include <functional>
 #include "core/device/vdb/visitor.hpp"
 #include "core/device/vdb/builtins.hpp"
@@ -34,25 +35,100 @@ class RegistryController {
      * on the other end of the line. This channel is open to be written to
      * immediately, however it is not guaranteed to be sent to the other side
      * until broadcasting has been completed
-     * Channel is only valid once negotiate has been callsed
+     * Channel is only valid once negotiate has been callsed.
+     * Open every channel before starting negotiation, the retry task walks the channel list
      * @param for_data the Part Pointer to the data the channel should hold
      * @return the channel id for the new channel created
      */
     ChannelID open_channel(PartPtr &for_data);
     /**
-     * sets the data at the channel id to a Part Pointer and sends it to the device
+     * sets the data at the channel id to a Part Pointer and sends it to the device.
+     * Also works on a scheduled channel, it waits for the scheduler's pass to finish first
      * @param id The id of the channel to hold the data
      * @param data the Part Pointer for the channel to hold and send to the device
      */
     bool send_data(ChannelID id);
 
     /**
-     * sends channel schematics to the Registry device and checks for ackowledgements
+     * Broadcasts every channel that hasn't been acked yet all at once and returns right away.
+     * A low priority task rebroadcasts the ones still missing an ack every ack_ms, up to BROADCAST_TRIES_PER times.
+     * send_data starts streaming a channel as soon as its own ack comes back, so this is safe to call from robot_init
+     */
+    void start_negotiation();
+    /**
+     * sends channel schematics to the Registry device and waits for all of the ackowledgements
      * @return whether or not all channel's were acknowledgements
      */
     bool negotiate();
+    /**
+     * @return true while some channel is still waiting on an ack and has retries left
+     */
+    bool negotiating() const { return negotiation_running; }
+    /**
+     * @param id the channel to check
+     * @return true once the other side has acked the channel
+     */
+    bool is_negotiated(ChannelID id) const { return id < channels.size() && channels[id].acked; }
+    /**
+     * Sends only the fields that changed since the last send, with a full keyframe every keyframe_interval sends.
+     * How far a Float has to move to count as changed is set per field with set_delta_epsilon()
+     * @param enabled whether send_data sends delta packets
+     * @param keyframe_interval how many delta packets may follow one full packet
+     */
+    void set_delta_encoding(bool enabled, uint32_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL);
+    /**
+     * Streams a channel at a fixed rate from the scheduler task instead of ad hoc send_data calls.
+     * Due channels go out earliest deadline first. When the link can't carry every requested rate,
+     * every scheduled channel slows down by the same proportion
+     * @param id the channel to schedule
+     * @param hz sends per second, 0 to stop scheduling it
+     */
+    void set_channel_rate(ChannelID id, float hz);
+    /**
+     * Starts the task that sends scheduled channels and requests responses every rec_switch_time ms
+     */
+    void start_scheduler();
+    /**
+     * Sends the scheduled channels that are due and fit in the link budget, the scheduler task calls this in a loop
+     * @param now the current time in ms
+     * @return ms until something is due again
+     */
+    uint32_t run_scheduler_once(uint32_t now);
+    /**
+     * Opens a channel that reports the requested, given and achieved rate, missed deadlines and drops of every
+     * scheduled channel back to the host once a second. Call after the set_channel_rate calls, before negotiating
+     * @return the channel id of the report
+     */
+    ChannelID open_scheduler_report();
+
+    /**
+     * How a scheduled channel is keeping up
+     */
+    struct ChannelStats {
+        float requested_hz; ///< the rate asked for in set_channel_rate
+        float effective_hz; ///< the rate the link budget allows right now
+        float achieved_hz;  ///< sends over the last second
+        uint32_t sent;
+        uint32_t missed_deadlines; ///< periods that went by without a send
+        uint32_t dropped;          ///< sends the device refused
+    };
+    /**
+     * @param id the channel to report on
+     * @return the channel's scheduling counters, all zero if it was never scheduled
+     */
+    ChannelStats get_channel_stats(ChannelID id);
+
     int rec_switch_time = 1000;
 
+    static constexpr uint32_t DEFAULT_KEYFRAME_INTERVAL = 25;
+    static constexpr uint8_t BROADCAST_TRIES_PER = 3;
+    /// share of the link scheduled channels may use, the rest is left for broadcasts, acks and requests
+    static constexpr float LINK_HEADROOM = 0.8f;
+    /// longest the scheduler task sleeps between checks
+    static constexpr uint32_t MAX_SCHEDULER_SLEEP_MS = 10;
+    /// packets waiting in the device past which the link budget is backed off
+    static constexpr uint32_t BACKLOG_HIGH_WATER = 8;
+
   private:
   std::vector<Channel> channels;
     ChannelID new_channel_id() {
@@ -61,11 +137,72 @@ class RegistryController {
         return id;
     }
 
-    int responses_in_queue;
+    /**
+     * Rebroadcasts the channels whose ack timed out until every channel is acked or out of retries
+     * @param self the RegistryController
+     */
+    static int negotiation_thread(void *self);
+    /**
+     * Sends the schema of one channel and counts the attempt
+     */
+    void broadcast_channel(Channel &chan, uint32_t now);
+    /**
+     * Retries channels that timed out and gives up on the ones out of retries
+     * @return true if some channel is still waiting on an ack
+     */
+    bool retry_broadcasts(uint32_t now);
+
+    /**
+     * Writes a channel's data (or the changes to it) and sends it
+     * @return whether the device took the packet
+     */
+    bool send_channel(Channel &chan);
+
+    /**
+     * Scheduling state of one channel, indexed by channel id
+     */
+    struct ChannelSchedule {
+        ChannelStats stats;
+        double deadline_ms;
+        // set on the first pass after the channel is acked, which is when deadline_ms starts counting
+        bool started;
+        // wire size of the last packet sent, what a send is charged against the budget
+        uint32_t packet_bytes;
+        uint32_t window_sent;
+    };
+    /**
+     * Gives every scheduled channel the same share of its requested rate, as much as the link budget allows
+     */
+    void update_rates(uint32_t now);
+    static int scheduler_thread(void *self);
+
+    std::vector<ChannelSchedule> schedule;
+    // held for the whole of a scheduler pass
+    vex::mutex schedule_mut;
+    std::atomic<bool> scheduler_running{false};
+    vex::task scheduler_task;
+    // token bucket of bytes the scheduled channels may still send
+    double link_tokens = 0;
+    uint32_t last_refill_ms = 0;
+    // backs off below 1 while the device can't keep up with the baud rate estimate
+    float link_scale = 1;
+    uint32_t last_feedback_ms = 0;
+    uint32_t window_start_ms = 0;
+    uint32_t last_request_ms = 0;
+
+    int responses_in_queue = 0;
     bool needs_ack = false;
+    std::atomic<bool> negotiation_running{false};
+    vex::task negotiation_task;
+    // held while broadcasting and while deciding whether the retry task is done
+    vex::mutex negotiation_mut;
+    // broadcasts are written here, send_data may be using the channel's own scratch once it's acked
+    Packet broadcast_scratch_space;
     vex::timer timer;
     bool rec_mode = false;
     static constexpr size_t ack_ms = 500;
+    bool delta_encoding = false;
+    uint32_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
 
     AbstractDevice *device;
     // Our channels (us -> them)
@@ -64,8 +64,17 @@ public:
         }
         // creates a PacketReader starting after the channel id location
         PacketReader reader{pac, 2};
-        // stores the data read from the packet to the Registry Part
-        part->read_data_from_message(reader);
+        if (header.delta) {
+          // only the changed fields are in the packet, the rest keep what the
+          // last one said
+          if (!channels[id].read_delta_message(reader)) {
+            VDPWarnf("Listener: Bad delta packet for channel %d. Skipping", (int)id);
+            return;
+          }
+        } else {
+          // stores the data read from the packet to the Registry Part
+          part->read_data_from_message(reader);
+        }
         // runs the channel's on data callback
         on_data(Channel{part, id});
       } else if (header.type == VDP::PacketType::Broadcast) {
@@ -184,15 +193,13 @@ public:
              (int)id);
       return false;
     }
-    // if it has been acknowledged write the channel's data to a packet and send
-    // it to the device
-    VDP::Packet scratch;
-    PacketWriter writ{scratch};
+    // if it has been acknowledged write the channel's data to its scratch
+    // packet and send it to the device. The scratch packet is reused every send
+    PacketWriter writ{chan.packet_scratch_space};
 
     writ.write_data_message(chan);
-    VDP::Packet pac = writ.get_packet();
 
-    return device->send_packet(pac);
+    return device->send_packet(writ.get_packet());
   };
   /**
    * sends channel schematics to the Registry device and checks for
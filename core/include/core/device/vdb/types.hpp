@@ -59,6 +59,12 @@ class Record : public Part {
      * @param sofar the PacketWriter to write with
      */
     void read_data_from_message(PacketReader &reader) override;
+    /**
+     * adds every field's data to a flat layout, in the order write_message writes them
+     * @param layout the layout to add to
+     * @return false if any field has no fixed size
+     */
+    bool add_to_layout(ChannelLayout &layout) override;
 
     PartPtr clone() override;
 
@@ -218,6 +224,19 @@ template <typename NumT, Type schemaType> class Number : public Part {
      * @param reader the packet reader to get the number from
      */
     void read_data_from_message(PacketReader &reader) override { value = reader.get_number<NumberType>(); }
+    /**
+     * adds the number's value to a flat layout
+     * @param layout the layout to add to
+     */
+    bool add_to_layout(ChannelLayout &layout) override {
+        layout.add_field(&value, sizeof(NumberType), SchemaType, delta_epsilon);
+        return true;
+    }
+    /**
+     * sets how far the number has to move before a delta packet sends it again
+     * @param epsilon the smallest change worth sending, 0 sends every change
+     */
+    void set_delta_epsilon(double epsilon) { delta_epsilon = epsilon; }
 
   protected:
     /**
@@ -234,7 +253,8 @@ template <typename NumT, Type schemaType> class Number : public Part {
      */
     void write_message(PacketWriter &sofar) const override { sofar.write_number<NumberType>(value); }
     FetchFunc fetcher;
-    NumberType value = (NumberType)0;    
+    NumberType value = (NumberType)0;
+    double delta_epsilon = 0;    
 };
 
 class Float : public Number<float, Type::Float> {
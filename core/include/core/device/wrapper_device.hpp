@@ -2,6 +2,7 @@
 #include "core/device/cobs_device.h"
 #include "core/device/vdb/protocol.hpp"
 #include "vex.h"
+#include <atomic>
 #include <deque>
 
 /**
@@ -10,9 +11,31 @@
 namespace VDB {
 class Device : public VDP::AbstractDevice, public COBSSerialDevice {
   public:
-    static constexpr int32_t NO_ACTIVITY_DELAY = 2; // ms
-    static constexpr std::size_t MAX_OUT_QUEUE_SIZE = 50;
+    // ms, longest the serial thread sleeps with nothing to do. Incoming bytes and send_packet wake it sooner
+    static constexpr int32_t NO_ACTIVITY_DELAY = 20;
+    // outbound slots per lane, powers of two. Acks and broadcasts are few but must not be dropped behind data
+    static constexpr std::size_t CONTROL_QUEUE_SIZE = 16;
+    static constexpr std::size_t DATA_QUEUE_SIZE = 64;
+    // bytes reserved in every outbound slot up front, bigger packets grow their slot once
+    static constexpr std::size_t OUT_SLOT_RESERVE = 128;
     static constexpr std::size_t MAX_IN_QUEUE_SIZE = 50;
+
+    /**
+     * Outbound lanes, the serial thread empties Control before it sends any Data
+     */
+    enum class Lane : uint8_t {
+        Control, ///< broadcasts, acks and requests
+        Data,    ///< data and response packets
+    };
+    /**
+     * Counters for one outbound lane
+     */
+    struct QueueStats {
+        uint32_t sent;      ///< packets written to the wire
+        uint32_t dropped;   ///< packets send_packet refused because the lane was full
+        uint32_t depth;     ///< packets waiting right now
+        uint32_t max_depth; ///< most packets that have waited at once
+    };
     /**
      * creates a COBS Serial device for VDB data at a specified port with a specified baud rate
      * @param port the port the debug board is connected to
@@ -28,13 +51,81 @@ class Device : public VDP::AbstractDevice, public COBSSerialDevice {
     void register_receive_callback(std::function<void(const VDP::Packet &packet)> callback
     ) override; // From VDP::AbstractDevice
 
+    /**
+     * @return bytes per second at the port's baud rate, 10 bits on the wire per byte
+     */
+    uint32_t link_bytes_per_second() const override;
+    /**
+     * @return packets waiting in both outbound lanes
+     */
+    uint32_t send_backlog() const override;
+
+    /**
+     * @param lane the outbound lane to report on
+     * @return the lane's counters
+     */
+    QueueStats get_queue_stats(Lane lane) const;
+
   private:
     /**
-     * @brief Packets that have been encoded and are waiting for their turn
-     * to be sent out on the wire
+     * Bounded multi producer, single consumer ring of preallocated packet slots.
+     * Any task may push, only the serial thread peeks and pops.
+     * Each slot carries a sequence number that says whose turn it is, so neither side takes a lock
+     * (Vyukov's bounded queue)
      */
-    std::deque<WirePacket> outbound_packets{};
-    vex::mutex outbound_mutex;
+    class OutboundLane {
+      public:
+        /**
+         * @param capacity number of slots, a power of two
+         */
+        explicit OutboundLane(std::size_t capacity);
+        ~OutboundLane();
+        OutboundLane(const OutboundLane &) = delete;
+        OutboundLane &operator=(const OutboundLane &) = delete;
+
+        /**
+         * copies a packet into the next free slot
+         * @return false if every slot is taken, the packet is dropped
+         */
+        bool push(const VDP::Packet &packet);
+        /**
+         * @return the oldest packet, or nullptr if the lane is empty. It stays valid until pop()
+         */
+        const WirePacket *peek();
+        /**
+         * hands the slot returned by peek() back to the producers
+         */
+        void pop();
+
+        QueueStats stats() const;
+
+      private:
+        struct Slot {
+            std::atomic<uint32_t> sequence;
+            WirePacket packet;
+        };
+        Slot *slots;
+        const uint32_t mask;
+        std::atomic<uint32_t> enqueue_pos;
+        std::atomic<uint32_t> dequeue_pos;
+
+        std::atomic<uint32_t> sent;
+        std::atomic<uint32_t> dropped;
+        std::atomic<uint32_t> max_depth;
+    };
+
+    /**
+     * @return the lane a packet is queued on, decided by its header
+     */
+    static Lane lane_for(const VDP::Packet &packet);
+
+    int32_t baud_rate;
+
+    /**
+     * @brief Packets that are waiting for their turn to be sent out on the wire
+     */
+    OutboundLane control_lane{CONTROL_QUEUE_SIZE};
+    OutboundLane data_lane{DATA_QUEUE_SIZE};
     /**
      * @brief Packets that have been read from the wire and split up but that are
      * still COBS encoded
@@ -47,6 +138,11 @@ class Device : public VDP::AbstractDevice, public COBSSerialDevice {
      * until it finds a full COBS packet
      */
     WirePacket inbound_buffer;
+    /**
+     * @brief The last packet handed to the receive callback, kept so its
+     * storage is reused
+     */
+    Packet decoded;
     /**
      * the thread for decoding data from the wire
      */
@@ -6,6 +6,7 @@
 #undef __ARM_NEON
 #include <Eigen/Dense>
 
+#include "core/device/serial_io_service.h"
 #include "core/subsystems/custom_encoder.h"
 #include "core/subsystems/odometry/odometry_base.h"
 #include "core/utils/math_util.h"
@@ -74,6 +75,7 @@ class OdometrySerial : public OdometryBase {
     Pose2d pose_offset;
 
     int32_t _port;
+    SerialIOService::Listener *rx_listener;
 
     bool calc_vel_acc_on_brain;
 
@@ -82,4 +84,9 @@ class OdometrySerial : public OdometryBase {
     double accel;
     double ang_speed_deg;
     double ang_accel_deg;
+
+    // bytes already read from the port but not yet handed out, they can run into the next packet
+    uint8_t rx_buffer[64];
+    size_t rx_head = 0;
+    size_t rx_len = 0;
 };
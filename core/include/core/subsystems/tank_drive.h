@@ -11,10 +11,12 @@
 #include "core/utils/command_structure/auto_command.h"
 #include "core/utils/controls/feedback_base.h"
 #include "core/utils/controls/pid.h"
+#include "core/utils/controls/state_space/linear_plant_inversion_feedforward.h"
 #include "core/utils/controls/state_space/ltv_differential_drive_controller.h"
 #include "core/utils/controls/state_space/tank_drive_model.h"
 #include "core/utils/controls/state_space/tank_drive_observer.h"
 #include "core/utils/trajectory/trajectory_generator.h"
+#include "core/utils/trajectory/trajectory_prefetch.h"
 #include "core/utils/pure_pursuit.h"
 #include "vex.h"
 #include <vector>
@@ -111,6 +113,17 @@ class TankDrive {
      */
     AutoCommand *FollowTrajectoryCmd(const Trajectory &trajectory, const TankTrajectoryFollowerConfig &cfg);
 
+    /**
+     * Returns an autonomous command that follows a trajectory prepared in the
+     * background, see TrajectoryPrefetch. The command only waits if the
+     * prefetch has not finished by the time it runs.
+     *
+     * @param prefetch The prefetch producing the trajectory and its gains.
+     * @param cfg Controller configuration and tuning parameters.
+     */
+    AutoCommand *
+    FollowTrajectoryCmd(const TrajectoryPrefetch::Handle &prefetch, const TankTrajectoryFollowerConfig &cfg);
+
     /**
      * Returns an autonomous command that replays the trajectory feedforward in
      * open loop.
@@ -185,9 +198,14 @@ class TankDrive {
      *
      * @param trajectory The trajectory to follow.
      * @param cfg Controller configuration and tuning parameters.
+     * @param gains Gain table to use, e.g. from a TrajectoryPrefetch. Looked up
+     * in LTVGainTableCache when NULL.
      * @return true once the trajectory has completed.
      */
-    bool follow_trajectory(const Trajectory &trajectory, const TankTrajectoryFollowerConfig &cfg);
+    bool follow_trajectory(
+      const Trajectory &trajectory,
+      const TankTrajectoryFollowerConfig &cfg,
+      std::shared_ptr<const LTVDifferentialDriveController::GainTable> gains = NULL);
 
     /**
      * Replays the nominal wheel feedforward from trajectory state in open
@@ -401,6 +419,7 @@ class TankDrive {
     double raw_right_position() const;
     bool pure_pursuit(PurePursuit::Path path, directionType dir, double max_speed = 1, double end_speed = 0);
     void print_trajectory_log();
+    LinearPlantInversionFeedforward<2, 2> &trajectory_feedforward_for(Time dt);
 
     struct TrajectoryLogRow {
         float t;
@@ -434,10 +453,14 @@ class TankDrive {
     TankDriveModel *drive_model = NULL;
     TankDriveObserver *drive_observer = NULL;
     LTVDifferentialDriveController *trajectory_controller = NULL;
+    LinearPlantInversionFeedforward<2, 2> *trajectory_feedforward = NULL; ///< discretized once per path
+    unsigned int trajectory_feedforward_revision = 0; ///< model revision trajectory_feedforward was built from
     TankDriveModel::StateVector trajectory_prev_wheel_ref = TankDriveModel::StateVector::Zero();
     Velocity line_prev_velocity_ref = 0_inps;
     std::vector<TrajectoryLogRow> trajectory_log;
     vex::timer trajectory_timer;
+    Trajectory::Sampler trajectory_sampler;           ///< cursor for the current reference
+    Trajectory::Sampler trajectory_lookahead_sampler; ///< cursor for the next-step reference (open loop)
     bool trajectory_settle_checking = false;
     double trajectory_settle_start = 0.0;
     int trajectory_print_row = 0;
@@ -46,6 +46,11 @@ class AutoCommand {
      * What to do if we timeout instead of finishing. timeout is specified by the timeout seconds in the constructor
      */
     virtual void on_timeout() {}
+    /**
+     * Called instead of run() when a Branch takes the other path, so commands that started work ahead of time (e.g. a
+     * trajectory prefetch) can cancel it
+     */
+    virtual void on_skipped() {}
     AutoCommand *withTimeout(double t_seconds) {
         if (this->timeout_seconds < 0) {
             // should never be timed out
@@ -156,6 +161,7 @@ class InOrder : public AutoCommand {
     InOrder(std::initializer_list<AutoCommand *> cmds);
     bool run() override;
     void on_timeout() override;
+    void on_skipped() override;
     std::string toString() override;
 
   private:
@@ -171,6 +177,7 @@ class Parallel : public AutoCommand {
     Parallel(std::initializer_list<AutoCommand *> cmds);
     bool run() override;
     void on_timeout() override;
+    void on_skipped() override;
     std::string toString() override;
 
   private:
@@ -188,6 +195,7 @@ class Branch : public AutoCommand {
     bool run() override;
     std::string toString() override;
     void on_timeout() override;
+    void on_skipped() override;
 
   private:
     AutoCommand *false_choice;
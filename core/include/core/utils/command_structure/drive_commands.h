@@ -300,15 +300,19 @@ private:
 class FollowTrajectoryCommand : public AutoCommand {
 public:
   FollowTrajectoryCommand(TankDrive &drive_sys, const Trajectory &trajectory, const TankTrajectoryFollowerConfig &cfg);
+  FollowTrajectoryCommand(
+    TankDrive &drive_sys, const TrajectoryPrefetch::Handle &prefetch, const TankTrajectoryFollowerConfig &cfg);
 
   bool run() override;
   std::string toString() override;
   void on_timeout() override;
+  void on_skipped() override;
 
 private:
   TankDrive &drive_sys;
   const Trajectory *trajectory;
   TankTrajectoryFollowerConfig cfg;
+  TrajectoryPrefetch::Handle prefetch; ///< NULL when following a trajectory given up front
 };
 
 class FollowTrajectoryOpenLoopCommand : public AutoCommand {
@@ -25,7 +25,7 @@ template <int STATES, int INPUTS> class LinearPlantInversionFeedforward {
      * @param dt The nominal timestep in seconds.
      */
     template <int OUTPUTS>
-    LinearPlantInversionFeedforward(LinearSystem<STATES, INPUTS, OUTPUTS> &plant, const double &dt)
+    LinearPlantInversionFeedforward(const LinearSystem<STATES, INPUTS, OUTPUTS> &plant, const double &dt)
         : LinearPlantInversionFeedforward(plant.A(), plant.B(), dt) {}
 
     /**
@@ -40,6 +40,7 @@ template <int STATES, int INPUTS> class LinearPlantInversionFeedforward {
         auto [Ad, Bd] = discretize_AB(A, B, dt);
         Ad_ = Ad;
         Bd_ = Bd;
+        Bd_qr_.compute(Bd_);
     }
 
     /**
@@ -55,7 +56,7 @@ template <int STATES, int INPUTS> class LinearPlantInversionFeedforward {
         // Bu = ẋ - Ax
         // u = B \ (ẋ - Ax)
         // u = B \ (next_r - Br)
-        uff_ = Bd_.householderQr().solve(next_r - (Ad_ * r));
+        uff_ = Bd_qr_.solve(next_r - (Ad_ * r));
         r_ = next_r;
 
         return uff_;
@@ -132,6 +133,11 @@ template <int STATES, int INPUTS> class LinearPlantInversionFeedforward {
      */
     void set_r(const EVec<STATES> &r) { r_ = r; }
 
+    /**
+     * Returns the nominal timestep in seconds the plant was discretized on.
+     */
+    double dt() const { return m_dt; }
+
   private:
     // The continuous system matrices
     EMat<STATES, STATES> A_;
@@ -140,6 +146,8 @@ template <int STATES, int INPUTS> class LinearPlantInversionFeedforward {
     // The discrete system matrices discretized on the nominal timestep
     EMat<STATES, STATES> Ad_;
     EMat<STATES, INPUTS> Bd_;
+    // Factored once so the nominal timestep path is just a solve
+    Eigen::HouseholderQR<EMat<STATES, INPUTS>> Bd_qr_;
 
     // The feedforward control input
     EVec<INPUTS> uff_;
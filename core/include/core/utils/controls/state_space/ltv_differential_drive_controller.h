@@ -2,12 +2,13 @@
 
 #include <array>
 #include <cmath>
+#include <memory>
 
 #include "core/units/types/geometry.h"
 #include "core/units/units.h"
 #include "core/utils/controls/state_space/differential_drive_wheel_voltages.h"
 #include "core/utils/math/eigen_interface.h"
-#include "core/utils/interpolating_map.h"
+#include "core/utils/uniform_interpolating_map.h"
 #include "core/utils/controls/state_space/linear_quadratic_regulator.h"
 #include "core/utils/math/geometry/pose2d.h"
 #include "core/utils/math/systems/dare_solver.h"
@@ -46,8 +47,16 @@ class LTVDifferentialDriveController {
     using QMatrix = EMat<5, 5>;
     using RMatrix = EMat<2, 2>;
 
+    // The velocity grid is uniform, so lookups are a direct index instead of a tree walk.
+    // LTVGainTableCache reads and writes the table through keys()/values(), so a
+    // replacement needs those as well as insert/operator[].
+    using GainTable = UniformInterpolatingMap<double, GainMatrix>;
+
+    /// Relative DARE residual at which each warm started solve stops, same as the SDA solver's
+    static constexpr double DARE_TOLERANCE = 1e-10;
+
     LTVDifferentialDriveController(
-      LinearSystem<2, 2, 2> &plant,
+      const LinearSystem<2, 2, 2> &plant,
       Length trackwidth,
       const ErrorVector &q_tolerances,
       const EVec<2> &r_tolerances,
@@ -55,24 +64,59 @@ class LTVDifferentialDriveController {
       Velocity max_velocity = 0_inps,
       Velocity velocity_step = 0.1_inps
     )
-        : m_tolerance(q_tolerances) {
-        const auto A_vel = plant.A();
-        const auto B_vel = plant.B();
+        : m_table(std::make_shared<GainTable>(
+            compute_gain_table(plant, trackwidth, q_tolerances, r_tolerances, dt, max_velocity, velocity_step)
+          )),
+          m_tolerance(q_tolerances) {}
+
+    /**
+     * Creates a controller from an already computed gain table, such as one
+     * obtained from LTVGainTableCache. No DAREs are solved here.
+     *
+     * @param table The velocity scheduled gain table.
+     * @param q_tolerances The state tolerances, used for at_reference().
+     */
+    LTVDifferentialDriveController(std::shared_ptr<const GainTable> table, const ErrorVector &q_tolerances)
+        : m_table(std::move(table)), m_tolerance(q_tolerances) {}
+
+    /**
+     * Solves the LQR problem for the linearized error dynamics at every
+     * velocity from -max_velocity to max_velocity in steps of velocity_step.
+     *
+     * This is expensive (one DARE per grid point), prefer LTVGainTableCache.
+     *
+     * @return The gain table, keyed by linear velocity in inches per second.
+     */
+    static GainTable compute_gain_table(
+      const LinearSystem<2, 2, 2> &plant,
+      Length trackwidth,
+      const ErrorVector &q_tolerances,
+      const EVec<2> &r_tolerances,
+      Time dt,
+      Velocity max_velocity = 0_inps,
+      Velocity velocity_step = 0.1_inps
+    ) {
+        GainTable table;
+        const EMat<2, 2> A_vel = plant.A();
+        const EMat<2, 2> B_vel = plant.B();
         const auto Q = cost_matrix<5>(q_tolerances);
         const auto R = cost_matrix<2>(r_tolerances);
 
         const Velocity max_v = max_velocity > 0_inps ? max_velocity : estimate_max_velocity(A_vel, B_vel);
         const Velocity step = std::max(velocity_step, 1e-3_inps);
 
+        // Neighboring velocities have nearly the same solution, so each DARE
+        // is warm started from the previous one
+        DARESweep<5, 2> sweep(Q, R, DARE_TOLERANCE);
         for (Velocity v = -max_v; v <= max_v + 1e-9_inps; v += step) {
             const Velocity linearized_velocity =
               abs(v) < 1e-4_inps ? (v < 0_inps ? -1e-4_inps : 1e-4_inps) : v;
             auto [A_cont, B_cont] = make_linearized_error_dynamics(A_vel, B_vel, trackwidth, linearized_velocity);
             auto [A_disc, B_disc] = discretize_AB(A_cont, B_cont, dt.s());
-            const auto S = DARE<5, 2>(A_disc, B_disc, Q, R);
-            const GainMatrix K = (B_disc.transpose() * S * B_disc + R).llt().solve(B_disc.transpose() * S * A_disc);
-            m_table.insert(v.inps(), K);
+            sweep.solve(A_disc, B_disc);
+            table.insert(v.inps(), sweep.gain());
         }
+        return table;
     }
 
     DifferentialDriveWheelVoltages calculate(
@@ -87,7 +131,7 @@ class LTVDifferentialDriveController {
         if (abs(linear_velocity) < 1e-3_inps) {
             linear_velocity = 0.5 * (left_velocity_ref + right_velocity_ref);
         }
-        const GainMatrix K = m_table[linear_velocity.inps()];
+        const GainMatrix K = (*m_table)[linear_velocity.inps()];
 
         const ErrorVector global_error{
           pose_ref.x() - current_pose.x(),
@@ -147,7 +191,7 @@ class LTVDifferentialDriveController {
         return Velocity::from<inches_per_second_tag>(std::max(0.1, 0.5 * (x_ss(0) + x_ss(1))));
     }
 
-    InterpolatingMap<double, GainMatrix> m_table;
+    std::shared_ptr<const GainTable> m_table;
     ErrorVector m_error = ErrorVector::Zero();
     ErrorVector m_tolerance = ErrorVector::Zero();
 };
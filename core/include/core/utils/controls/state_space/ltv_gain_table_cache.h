@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/utils/controls/state_space/ltv_differential_drive_controller.h"
+
+/**
+ * Process wide cache of LTVDifferentialDriveController gain tables.
+ *
+ * Building a gain table solves one DARE per velocity grid point, which takes
+ * long enough to stall the first control ticks of a trajectory. Tables are
+ * computed once per (plant, trackwidth, Q, R, dt, velocity grid) key, kept in
+ * memory (up to MAX_TABLES of them), and can be persisted to / reloaded from
+ * the SD card so a warm robot never has to solve them at all.
+ *
+ * Typical use:
+ *   robot_init():   LTVGainTableCache::load_from_sd();
+ *                   LTVGainTableCache::get(plant, trackwidth, cfg); // precompute
+ *                   LTVGainTableCache::save_to_sd();                // only writes if something new was computed
+ *   follower:       new LTVDifferentialDriveController(LTVGainTableCache::get(...), q);
+ */
+class LTVGainTableCache {
+  public:
+    using GainMatrix = LTVDifferentialDriveController::GainMatrix;
+    using GainTable = LTVDifferentialDriveController::GainTable;
+    using TablePtr = std::shared_ptr<const GainTable>;
+
+    /// A, B (2x2 each), trackwidth, q (5), r (2), dt, max velocity, velocity step
+    static constexpr int KEY_SIZE = 4 + 4 + 1 + 5 + 2 + 1 + 1 + 1;
+    using Key = std::array<double, KEY_SIZE>;
+
+    /// Bump whenever the file layout or the gain computation changes
+    static constexpr uint16_t FILE_VERSION = 1;
+    /// Tables kept in memory, the least recently used one is dropped past this
+    static constexpr size_t MAX_TABLES = 8;
+    static constexpr const char *DEFAULT_FILENAME = "ltv_gains.bin";
+
+    /**
+     * Builds the cache key for a set of controller parameters.
+     */
+    static Key make_key(
+      const LinearSystem<2, 2, 2> &plant,
+      Length trackwidth,
+      const EVec<5> &q_tolerances,
+      const EVec<2> &r_tolerances,
+      Time dt,
+      Velocity max_velocity,
+      Velocity velocity_step
+    );
+
+    /**
+     * Returns the gain table for these parameters, computing (and caching) it
+     * if it has not been computed or loaded yet. Every change of the drive
+     * gains is a new key, so expect a solve on the first path after one.
+     */
+    static TablePtr get(
+      const LinearSystem<2, 2, 2> &plant,
+      Length trackwidth,
+      const EVec<5> &q_tolerances,
+      const EVec<2> &r_tolerances,
+      Time dt,
+      Velocity max_velocity,
+      Velocity velocity_step
+    );
+
+    /**
+     * Convenience overload pulling the tolerances, dt and grid from a follower
+     * config.
+     */
+    static TablePtr get(const LinearSystem<2, 2, 2> &plant, Length trackwidth, const TankTrajectoryFollowerConfig &cfg);
+
+    /**
+     * @return true if a table for this key is already in memory.
+     */
+    static bool contains(const Key &key);
+
+    /**
+     * Reads every table in the file into memory. Tables already in memory are
+     * kept. A missing file, a file from a different FILE_VERSION, or a
+     * truncated file is ignored (with a printout) and nothing is loaded.
+     *
+     * @return true if the file was read successfully.
+     */
+    static bool load_from_sd(const std::string &filename = DEFAULT_FILENAME);
+
+    /**
+     * Writes the tables that get() was asked for since boot to the SD card,
+     * if one was computed or a loaded one went unused. Tables no config asked
+     * for are left out of the file, so call this after every config has been
+     * precomputed.
+     *
+     * @return true if the cache is now in sync with the file.
+     */
+    static bool save_to_sd(const std::string &filename = DEFAULT_FILENAME);
+
+    /**
+     * @return true if a table has been computed that is not yet on the SD card.
+     */
+    static bool is_dirty();
+
+    /**
+     * Drops every table from memory. Controllers holding a table keep theirs.
+     */
+    static void clear();
+};
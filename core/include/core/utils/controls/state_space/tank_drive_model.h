@@ -39,7 +39,10 @@ class TankDriveModel {
           kV_linear_(kV_linear),
           kA_linear_(kA_linear),
           kV_angular_(kV_angular),
-          kA_angular_(kA_angular) {}
+          kA_angular_(kA_angular),
+          chassis_plant_(build_chassis_plant()),
+          wheel_plant_(build_wheel_plant()),
+          wheel_position_plant_(build_wheel_position_plant()) {}
 
     units::Length trackwidth() const { return trackwidth_; }
     units::Voltage max_voltage() const { return max_voltage_; }
@@ -49,76 +52,49 @@ class TankDriveModel {
     AngularKV kV_angular() const { return kV_angular_; }
     AngularKA kA_angular() const { return kA_angular_; }
 
-    EVec<2> wheel_stiction_voltages(const StateVector &wheel_velocity_ref) const {
-        return EVec<2>{
-          kS_.V() * signum(wheel_velocity_ref(0)),
-          kS_.V() * signum(wheel_velocity_ref(1)),
-        };
+    /**
+     * Incremented every time the gains change, so holders of anything derived
+     * from the plants (e.g. a discretized feedforward) know to rebuild it.
+     */
+    unsigned int revision() const { return revision_; }
+
+    /**
+     * Replaces the drive gains, e.g. with fresh estimates from an online
+     * identifier, and rebuilds the cached plants. The plants are swapped
+     * without a lock, so only call this while no path or observer is running.
+     */
+    void set_gains(LinearKV kV_linear, LinearKA kA_linear, AngularKV kV_angular, AngularKA kA_angular) {
+        kV_linear_ = kV_linear;
+        kA_linear_ = kA_linear;
+        kV_angular_ = kV_angular;
+        kA_angular_ = kA_angular;
+        rebuild_plants();
     }
 
-    Plant chassis_plant() const {
-        const double linear_kv = kV_linear_.VpInps();
-        const double linear_ka = kA_linear_.VpInps2();
-        const double angular_kv = kV_angular_.VpRadPs();
-        const double angular_ka = kA_angular_.VpRadPs2();
-
-        const Plant::MatrixA A{
-          {-linear_kv / linear_ka, 0.0},
-          {0.0, -angular_kv / angular_ka},
-        };
-
-        const Plant::MatrixB B{
-          {0.5 / linear_ka, 0.5 / linear_ka},
-          {-0.5 / angular_ka, 0.5 / angular_ka},
-        };
+    void set_linear_gains(LinearKV kV_linear, LinearKA kA_linear) {
+        set_gains(kV_linear, kA_linear, kV_angular_, kA_angular_);
+    }
 
-        return Plant(A, B, Plant::MatrixC::Identity(), Plant::MatrixD::Zero());
+    void set_angular_gains(AngularKV kV_angular, AngularKA kA_angular) {
+        set_gains(kV_linear_, kA_linear_, kV_angular, kA_angular);
     }
 
-    Plant wheel_plant() const {
-        Plant chassis = chassis_plant();
-        const double trackwidth = trackwidth_.in();
+    void set_kS(WheelKS kS) { kS_ = kS; }
 
-        const EMat<2, 2> M{
-          {0.5, 0.5},
-          {-1.0 / trackwidth, 1.0 / trackwidth},
-        };
-        const EMat<2, 2> M_inv{
-          {1.0, -trackwidth / 2.0},
-          {1.0, trackwidth / 2.0},
+    EVec<2> wheel_stiction_voltages(const StateVector &wheel_velocity_ref) const {
+        return EVec<2>{
+          kS_.V() * signum(wheel_velocity_ref(0)),
+          kS_.V() * signum(wheel_velocity_ref(1)),
         };
-
-        Plant::MatrixA A = M_inv * chassis.A() * M;
-        Plant::MatrixB B = M_inv * chassis.B();
-        return Plant(A, B, Plant::MatrixC::Identity(), Plant::MatrixD::Zero());
     }
 
-    ObserverPlant wheel_position_plant() const {
-        Plant velocity_plant = wheel_plant();
-        Plant::MatrixA A_vel = velocity_plant.A();
-        Plant::MatrixB B_vel = velocity_plant.B();
-
-        ObserverPlant::MatrixA A = ObserverPlant::MatrixA::Zero();
-        ObserverPlant::MatrixB B = ObserverPlant::MatrixB::Zero();
-        ObserverPlant::MatrixC C = ObserverPlant::MatrixC::Zero();
-
-        A(0, 1) = 1.0;
-        A(2, 3) = 1.0;
-        A(1, 1) = A_vel(0, 0);
-        A(1, 3) = A_vel(0, 1);
-        A(3, 1) = A_vel(1, 0);
-        A(3, 3) = A_vel(1, 1);
-
-        B.template block<1, 2>(1, 0) = B_vel.template block<1, 2>(0, 0);
-        B.template block<1, 2>(3, 0) = B_vel.template block<1, 2>(1, 0);
-
-        C(0, 0) = 1.0;
-        C(1, 1) = 1.0;
-        C(2, 2) = 1.0;
-        C(3, 3) = 1.0;
-
-        return ObserverPlant(A, B, C, ObserverPlant::MatrixD::Zero());
-    }
+    /**
+     * The plants only depend on the gains and trackwidth, so they are built once
+     * and on every gain change instead of on every call.
+     */
+    const Plant &chassis_plant() const { return chassis_plant_; }
+    const Plant &wheel_plant() const { return wheel_plant_; }
+    const ObserverPlant &wheel_position_plant() const { return wheel_position_plant_; }
 
     StateVector chassis_to_wheels(units::Velocity linear_velocity, units::AngularVelocity angular_velocity) const {
         const units::Length half_trackwidth = trackwidth_ * 0.5;
@@ -183,6 +159,77 @@ class TankDriveModel {
     }
 
   private:
+    Plant build_chassis_plant() const {
+        const double linear_kv = kV_linear_.VpInps();
+        const double linear_ka = kA_linear_.VpInps2();
+        const double angular_kv = kV_angular_.VpRadPs();
+        const double angular_ka = kA_angular_.VpRadPs2();
+
+        const Plant::MatrixA A{
+          {-linear_kv / linear_ka, 0.0},
+          {0.0, -angular_kv / angular_ka},
+        };
+
+        const Plant::MatrixB B{
+          {0.5 / linear_ka, 0.5 / linear_ka},
+          {-0.5 / angular_ka, 0.5 / angular_ka},
+        };
+
+        return Plant(A, B, Plant::MatrixC::Identity(), Plant::MatrixD::Zero());
+    }
+
+    Plant build_wheel_plant() const {
+        const Plant &chassis = chassis_plant_;
+        const double trackwidth = trackwidth_.in();
+
+        const EMat<2, 2> M{
+          {0.5, 0.5},
+          {-1.0 / trackwidth, 1.0 / trackwidth},
+        };
+        const EMat<2, 2> M_inv{
+          {1.0, -trackwidth / 2.0},
+          {1.0, trackwidth / 2.0},
+        };
+
+        Plant::MatrixA A = M_inv * chassis.A() * M;
+        Plant::MatrixB B = M_inv * chassis.B();
+        return Plant(A, B, Plant::MatrixC::Identity(), Plant::MatrixD::Zero());
+    }
+
+    ObserverPlant build_wheel_position_plant() const {
+        const Plant &velocity_plant = wheel_plant_;
+        Plant::MatrixA A_vel = velocity_plant.A();
+        Plant::MatrixB B_vel = velocity_plant.B();
+
+        ObserverPlant::MatrixA A = ObserverPlant::MatrixA::Zero();
+        ObserverPlant::MatrixB B = ObserverPlant::MatrixB::Zero();
+        ObserverPlant::MatrixC C = ObserverPlant::MatrixC::Zero();
+
+        A(0, 1) = 1.0;
+        A(2, 3) = 1.0;
+        A(1, 1) = A_vel(0, 0);
+        A(1, 3) = A_vel(0, 1);
+        A(3, 1) = A_vel(1, 0);
+        A(3, 3) = A_vel(1, 1);
+
+        B.template block<1, 2>(1, 0) = B_vel.template block<1, 2>(0, 0);
+        B.template block<1, 2>(3, 0) = B_vel.template block<1, 2>(1, 0);
+
+        C(0, 0) = 1.0;
+        C(1, 1) = 1.0;
+        C(2, 2) = 1.0;
+        C(3, 3) = 1.0;
+
+        return ObserverPlant(A, B, C, ObserverPlant::MatrixD::Zero());
+    }
+
+    void rebuild_plants() {
+        chassis_plant_ = build_chassis_plant();
+        wheel_plant_ = build_wheel_plant();
+        wheel_position_plant_ = build_wheel_position_plant();
+        revision_++;
+    }
+
     static double signum(double value) {
         if (value > 0.0) {
             return 1.0;
@@ -200,4 +247,10 @@ class TankDriveModel {
     LinearKA kA_linear_;
     AngularKV kV_angular_;
     AngularKA kA_angular_;
+
+    // Built from the gains above, declared after them so they are initialized last
+    Plant chassis_plant_;
+    Plant wheel_plant_;
+    ObserverPlant wheel_position_plant_;
+    unsigned int revision_ = 0;
 };
@@ -19,7 +19,10 @@ class TankDriveObserver {
       units::Time dt,
       const StateVector &state_stddevs = default_state_stddevs(),
         const OutputVector &measurement_stddevs = default_measurement_stddevs())
-        : model_(model), dt_(dt), plant_(model.wheel_position_plant()), filter_(plant_, state_stddevs, measurement_stddevs) {}
+        : model_(model), dt_(dt), plant_(model.wheel_position_plant()), filter_(plant_, state_stddevs, measurement_stddevs) {
+        // The plant and rate never change, so the gain converges to a constant anyway
+        filter_.enable_steady_state(dt_.s());
+    }
     TankDriveObserver(
       const TankDriveModel &model,
       double dt,
@@ -62,6 +65,20 @@ class TankDriveObserver {
 
     bool initialized() const { return initialized_; }
 
+    /**
+     * Chooses between the fixed steady state gain (the default) and a full
+     * covariance update every step.
+     */
+    void set_steady_state(bool enabled) {
+        if (enabled) {
+            filter_.enable_steady_state(dt_.s());
+        } else {
+            filter_.disable_steady_state();
+        }
+    }
+
+    bool steady_state() const { return filter_.steady_state(); }
+
     void set_measurement_provider(MeasurementProvider provider) { measurement_provider_ = provider; }
 
     bool has_measurement_provider() const { return static_cast<bool>(measurement_provider_); }
@@ -35,7 +35,7 @@ template <typename KEY, typename VALUE> class InterpolatingMap {
      * 
      * @return The value.
      */
-    VALUE operator[](const KEY &key) {
+    VALUE operator[](const KEY &key) const {
         // Get iterator for the upper bound of our key.
         typename MapType::const_iterator upper = map_.upper_bound(key);
 
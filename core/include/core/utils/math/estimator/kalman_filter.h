@@ -2,6 +2,7 @@
 
 #include "core/utils/math/eigen_interface.h"
 
+#include "core/utils/math/systems/dare_solver.h"
 #include "core/utils/math/systems/linear_system.h"
 
 /**
@@ -17,6 +18,13 @@
  * To read more about Kalman filters read:
  * https://github.com/rlabbe/Kalman-and-Bayesian-Filters-in-Python
  *
+ * The discretized A, B and Q are cached for the last few distinct timesteps,
+ * so a filter run at a fixed rate only computes the matrix exponential once.
+ *
+ * For a time invariant system run at a fixed rate the covariance and gain
+ * converge to constants. enable_steady_state() solves for them once, after
+ * which predict and correct only update x-hat.
+ *
  * @tparam STATES Dimension of the state vector.
  * @tparam INPUTS Dimension of the control input vector.
  * @tparam OUTPUTS Dimension of the measurement vector.
@@ -30,6 +38,9 @@ template <int STATES, int INPUTS, int OUTPUTS> class KalmanFilter {
     using StateMatrix = EMat<STATES, STATES>;
     using InputMatrix = EMat<STATES, INPUTS>;
 
+    /// Number of distinct timesteps whose discretization is kept
+    static constexpr int DISCRETIZATION_CACHE_SIZE = 4;
+
     /**
      * Constructs a Kalman filter.
      *
@@ -111,9 +122,61 @@ template <int STATES, int INPUTS, int OUTPUTS> class KalmanFilter {
      */
     void reset() {
         xhat_.setZero();
-        P_.setZero();
+        if (steady_state_) {
+            P_ = steady_P_posterior_;
+        } else {
+            P_.setZero();
+        }
+    }
+
+    /**
+     * Switches to a fixed gain filter for a constant timestep.
+     *
+     * The steady state prior covariance is the solution of the DARE
+     *
+     *   P = APAᵀ − APCᵀ(CPCᵀ + R)⁻¹CPAᵀ + Q
+     *
+     * which gives the gain K = PCᵀ(CPCᵀ + R)⁻¹. From then on predict is
+     * x̂ = Ax̂ + Bu and correct is x̂ += K(y − Cx̂ − Du), with no covariance
+     * updates.
+     *
+     * A predict with a different dt, or a correct with a custom C, D or R,
+     * leaves steady state mode and continues as a normal filter from the
+     * steady state covariance.
+     *
+     * @param dt The timestep in seconds predict will be called with.
+     */
+    void enable_steady_state(double dt) {
+        const Discretization &disc = discretization(dt);
+
+        const StateMatrix At = disc.A.transpose();
+        const EMat<STATES, OUTPUTS> Ct = C_.transpose();
+        steady_P_prior_ = DARE<STATES, OUTPUTS>(At, Ct, disc.Q, R_);
+
+        const EMat<OUTPUTS, OUTPUTS> S = C_ * steady_P_prior_ * C_.transpose() + R_;
+        steady_K_ = S.transpose().ldlt().solve(C_ * steady_P_prior_.transpose()).transpose();
+        steady_P_posterior_ = (StateMatrix::Identity() - steady_K_ * C_) * steady_P_prior_;
+
+        steady_dt_ = dt;
+        steady_state_ = true;
+        P_ = steady_P_posterior_;
     }
 
+    /**
+     * Goes back to updating the covariance every step.
+     */
+    void disable_steady_state() { steady_state_ = false; }
+
+    /**
+     * Returns true if the filter is using a fixed gain.
+     */
+    bool steady_state() const { return steady_state_; }
+
+    /**
+     * Returns the steady state Kalman gain, valid after enable_steady_state().
+     */
+    const EMat<STATES, OUTPUTS> &steady_state_gain() const { return steady_K_; }
+
     /**
      * Projects the state into the future by dt seconds with control input u.
      *
@@ -121,15 +184,21 @@ template <int STATES, int INPUTS, int OUTPUTS> class KalmanFilter {
      * @param dt The timestep in seconds.
      */
     void predict(const InputVector &u, const double &dt) {
-        // Q is discrete sqrt(process noise)
-        EMat<STATES, STATES> Q = Q_ * dt;
-        auto [A, B] = discretize_AB(A_, B_, dt);
+        if (steady_state_ && dt != steady_dt_) {
+            steady_state_ = false;
+        }
+
+        const Discretization &disc = discretization(dt);
 
         // Compute prior mean
-        xhat_ = A * xhat_ + B * u;
+        xhat_ = disc.A * xhat_ + disc.B * u;
+
+        if (steady_state_) {
+            return;
+        }
 
         // Compute prior covariance
-        P_ = A * P_ * A.transpose() + Q;
+        P_ = disc.A * P_ * disc.A.transpose() + disc.Q;
     }
 
     /**
@@ -138,7 +207,13 @@ template <int STATES, int INPUTS, int OUTPUTS> class KalmanFilter {
      * @param y The vector of measurements.
      * @param u The control input used in the last predict step.
      */
-    void correct(const OutputVector &y, const InputVector &u) { correct<OUTPUTS>(y, u, C_, D_, R_); }
+    void correct(const OutputVector &y, const InputVector &u) {
+        if (steady_state_) {
+            xhat_ += steady_K_ * (y - (C_ * xhat_ + D_ * u));
+            return;
+        }
+        correct<OUTPUTS>(y, u, C_, D_, R_);
+    }
 
     /**
      * Correct the state estimate using the measurements in y, and custom
@@ -170,6 +245,12 @@ template <int STATES, int INPUTS, int OUTPUTS> class KalmanFilter {
       const EVec<ROWS> &y, const InputVector &u, const EMat<ROWS, STATES> &C, const EMat<ROWS, INPUTS> &D,
       const EMat<ROWS, ROWS> &R
     ) {
+        if (steady_state_) {
+            // The fixed gain only fits the plant's own C, D and R
+            steady_state_ = false;
+            P_ = steady_P_prior_;
+        }
+
         // Compute the innovation covariance
         //
         //   Py = CPCᵀ + R
@@ -197,6 +278,36 @@ template <int STATES, int INPUTS, int OUTPUTS> class KalmanFilter {
     }
 
   private:
+    struct Discretization {
+        double dt = -1.0;
+        StateMatrix A;
+        InputMatrix B;
+        StateMatrix Q;
+    };
+
+    /**
+     * Returns the discretized A, B and Q for dt, computing them only if dt
+     * isn't one of the cached timesteps.
+     */
+    const Discretization &discretization(double dt) {
+        for (const Discretization &disc : disc_cache_) {
+            if (disc.dt == dt) {
+                return disc;
+            }
+        }
+
+        Discretization &disc = disc_cache_[disc_cache_next_];
+        disc_cache_next_ = (disc_cache_next_ + 1) % DISCRETIZATION_CACHE_SIZE;
+
+        auto [A, B] = discretize_AB(A_, B_, dt);
+        disc.dt = dt;
+        disc.A = A;
+        disc.B = B;
+        // Q is discrete sqrt(process noise)
+        disc.Q = Q_ * dt;
+        return disc;
+    }
+
     StateVector xhat_;
     StateMatrix P_;
 
@@ -208,7 +319,14 @@ template <int STATES, int INPUTS, int OUTPUTS> class KalmanFilter {
     EMat<OUTPUTS, STATES> C_;
     EMat<OUTPUTS, INPUTS> D_;
 
-    double dt_;
+    Discretization disc_cache_[DISCRETIZATION_CACHE_SIZE];
+    int disc_cache_next_ = 0;
+
+    bool steady_state_ = false;
+    double steady_dt_ = 0.0;
+    EMat<STATES, OUTPUTS> steady_K_;
+    StateMatrix steady_P_prior_;
+    StateMatrix steady_P_posterior_;
 };
 
 // allow using both names
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+
 #include "core/utils/math/eigen_interface.h"
 
 /**
@@ -98,3 +100,205 @@ EMat<STATES, STATES> DARE(
 
     return H_k1;
 }
+
+/**
+ * Solves the discrete Stein (Lyapunov) equation
+ *
+ *   X = AᵀXA + M
+ *
+ * with Smith's doubling iteration, X = Σₖ (Aᵀ)ᵏMAᵏ summed 2ⁱ terms at a time:
+ *
+ *   Xᵢ₊₁ = Xᵢ + AᵢᵀXᵢAᵢ
+ *   Aᵢ₊₁ = Aᵢ²
+ *
+ * A must be stable (all eigenvalues inside the unit circle). If it isn't, the
+ * result grows without bound or becomes non-finite, so callers can tell.
+ *
+ * @tparam STATES Number of STATES.
+ * @param A The closed loop system matrix.
+ * @param M The constant term.
+ * @return The solution X.
+ */
+template <int STATES>
+EMat<STATES, STATES> discrete_stein(const EMat<STATES, STATES> &A, const EMat<STATES, STATES> &M) {
+    static constexpr int MAX_DOUBLINGS = 64;
+
+    EMat<STATES, STATES> X = M;
+    EMat<STATES, STATES> A_i = A;
+    for (int i = 0; i < MAX_DOUBLINGS; i++) {
+        const EMat<STATES, STATES> increment = A_i.transpose() * X * A_i;
+        X += increment;
+        if (!(increment.norm() > 1e-16 * X.norm())) {
+            break;
+        }
+        A_i = A_i * A_i;
+    }
+    return X;
+}
+
+/**
+ * Solves a sequence of closely related DAREs, such as the LQR problems of a
+ * gain schedule, by warm starting each one from the previous solutions.
+ *
+ * The starting guess is the linear extrapolation of the last two solutions.
+ * From there Newton–Kleinman (Hewer) iterations
+ *
+ *   K = (BᵀXB + R)⁻¹BᵀXA
+ *   X = (A − BK)ᵀX(A − BK) + Q + KᵀRK
+ *
+ * converge quadratically, so a close guess needs zero or one iteration.
+ * Iteration stops once the relative DARE residual is below tolerance. To
+ * first order that is also the relative error of X and of the gain, so pick
+ * it from how accurate the gains need to be.
+ *
+ * The first solve, and any solve whose warm start doesn't converge (e.g. the
+ * guess doesn't stabilize the new system), falls back to the SDA solver above.
+ *
+ * @tparam STATES Number of STATES.
+ * @tparam INPUTS Number of INPUTS.
+ */
+template <int STATES, int INPUTS> class DARESweep {
+  public:
+    using StateMatrix = EMat<STATES, STATES>;
+    using InputMatrix = EMat<STATES, INPUTS>;
+    using GainMatrix = EMat<INPUTS, STATES>;
+
+    /**
+     * Totals over every solve since construction or reset()
+     */
+    struct Stats {
+        int solves = 0;
+        int cold_starts = 0;
+        int iterations = 0;
+        int max_iterations = 0;
+        double max_residual = 0.0;
+    };
+
+    /**
+     * @param Q The state cost matrix, shared by every problem.
+     * @param R The input cost matrix, shared by every problem.
+     * @param tolerance Stop once the relative DARE residual is below this.
+     * @param max_iterations Newton iterations before falling back to SDA.
+     */
+    DARESweep(const StateMatrix &Q, const EMat<INPUTS, INPUTS> &R, double tolerance = 1e-9, int max_iterations = 8)
+        : m_Q(Q), m_R(R), m_tolerance(tolerance), m_max_iterations(max_iterations) {}
+
+    /**
+     * Solves the DARE for (A, B), warm started from the previous solves.
+     *
+     * @return The solution X. The matching gain is gain().
+     */
+    const StateMatrix &solve(const StateMatrix &A, const InputMatrix &B) {
+        m_last_iterations = 0;
+
+        StateMatrix guess = m_X;
+        if (m_solutions >= 2) {
+            guess = 2.0 * m_X - m_X_prev;
+        }
+        m_X_prev = m_X;
+
+        m_last_cold_start = m_solutions == 0 || !refine(A, B, guess);
+        if (m_last_cold_start) {
+            m_X = DARE<STATES, INPUTS>(A, B, m_Q, m_R);
+            m_K = gain_for(A, B, m_X);
+            m_last_residual = residual(A, B, m_X, m_K);
+            m_stats.cold_starts++;
+        }
+        m_solutions++;
+
+        m_stats.solves++;
+        m_stats.iterations += m_last_iterations;
+        m_stats.max_iterations = std::max(m_stats.max_iterations, m_last_iterations);
+        m_stats.max_residual = std::max(m_stats.max_residual, m_last_residual);
+        return m_X;
+    }
+
+    /**
+     * The optimal gain K = (BᵀXB + R)⁻¹BᵀXA for the last solve.
+     */
+    const GainMatrix &gain() const { return m_K; }
+
+    /**
+     * The last solution X.
+     */
+    const StateMatrix &solution() const { return m_X; }
+
+    /**
+     * Newton iterations the last solve ran. When the warm start didn't
+     * converge and the solve fell back to SDA (last_cold_start()), these are
+     * the iterations tried before giving up, 0 only for the very first solve.
+     */
+    int last_iterations() const { return m_last_iterations; }
+
+    /**
+     * True if the last solve fell back to SDA.
+     */
+    bool last_cold_start() const { return m_last_cold_start; }
+
+    /**
+     * ‖AᵀXA − X − AᵀXB(BᵀXB + R)⁻¹BᵀXA + Q‖ / ‖X‖ for the last solve.
+     */
+    double last_residual() const { return m_last_residual; }
+
+    const Stats &stats() const { return m_stats; }
+
+    /**
+     * Forgets the previous solution, so the next solve is a cold start.
+     */
+    void reset() {
+        m_solutions = 0;
+        m_stats = Stats();
+    }
+
+    /**
+     * Relative residual of a candidate solution X of the DARE for (A, B),
+     * given its gain K.
+     */
+    double residual(const StateMatrix &A, const InputMatrix &B, const StateMatrix &X, const GainMatrix &K) const {
+        const StateMatrix res = A.transpose() * X * (A - B * K) - X + m_Q;
+        return res.norm() / std::max(X.norm(), 1e-300);
+    }
+
+  private:
+    GainMatrix gain_for(const StateMatrix &A, const InputMatrix &B, const StateMatrix &X) const {
+        return (B.transpose() * X * B + m_R).llt().solve(B.transpose() * X * A);
+    }
+
+    // Newton–Kleinman from the guess. Returns false if it doesn't converge,
+    // leaving the caller to cold start.
+    bool refine(const StateMatrix &A, const InputMatrix &B, StateMatrix X) {
+        for (int i = 0;; i++) {
+            const GainMatrix K = gain_for(A, B, X);
+            const double res = residual(A, B, X, K);
+            if (!(res <= m_tolerance || i == m_max_iterations)) {
+                X = discrete_stein<STATES>(A - B * K, m_Q + K.transpose() * m_R * K);
+                m_last_iterations = i + 1;
+                continue;
+            }
+
+            // The stabilizing solution is the only positive semidefinite one
+            if (!(res <= m_tolerance) || X.ldlt().vectorD().minCoeff() < -1e-9 * X.norm()) {
+                return false;
+            }
+            m_X = X;
+            m_K = K;
+            m_last_residual = res;
+            return true;
+        }
+    }
+
+    StateMatrix m_Q;
+    EMat<INPUTS, INPUTS> m_R;
+    double m_tolerance;
+    int m_max_iterations;
+
+    int m_solutions = 0;
+    StateMatrix m_X;
+    StateMatrix m_X_prev;
+    GainMatrix m_K;
+
+    int m_last_iterations = 0;
+    bool m_last_cold_start = true;
+    double m_last_residual = 0.0;
+    Stats m_stats;
+};
@@ -8,7 +8,11 @@
 
 /**
  * Discretizes the continuous system and input matrices (A and B) over the
- * timestep dt in seconds.
+ * timestep dt in seconds, using Eigen's matrix exponential of the augmented
+ * matrix.
+ *
+ * This is the general reference implementation, discretize_AB picks a faster
+ * kernel for small systems.
  * 
  * @tparam STATES Dimension of the state matrix.
  * @tparam INPUTS Dimension of the input matrix.
@@ -18,7 +22,7 @@
  * @param dt The timestep in seconds.
  */
 template <int STATES, int INPUTS>
-std::tuple<EMat<STATES, STATES>, EMat<STATES, INPUTS>> discretize_AB(EMat<STATES, STATES> Ac, EMat<STATES, INPUTS> Bc, const double &dt) {
+std::tuple<EMat<STATES, STATES>, EMat<STATES, INPUTS>> discretize_AB_pade(const EMat<STATES, STATES> &Ac, const EMat<STATES, INPUTS> &Bc, const double &dt) {
     // Form the intermediate matrix M
     //
     //       [A B]
@@ -38,3 +42,112 @@ std::tuple<EMat<STATES, STATES>, EMat<STATES, INPUTS>> discretize_AB(EMat<STATES
     // Extract Ad and Bd from phi and put them in a tuple
     return std::make_tuple(phi.template block<STATES, STATES>(0, 0), phi.template block<STATES, INPUTS>(0, STATES));
 }
+
+/**
+ * Discretizes a single state system in closed form.
+ *
+ *   Ad = e^(a T)
+ *   Bd = (e^(a T) - 1) / a * b
+ *
+ * expm1 keeps Bd accurate when aT is small, and aT = 0 falls back to Bd = bT.
+ */
+template <int INPUTS>
+std::tuple<EMat<1, 1>, EMat<1, INPUTS>> discretize_AB_scalar(const EMat<1, 1> &Ac, const EMat<1, INPUTS> &Bc, const double &dt) {
+    const double a = Ac(0, 0);
+    const double aT = a * dt;
+
+    EMat<1, 1> Ad;
+    Ad(0, 0) = std::exp(aT);
+    const double gamma = aT == 0.0 ? dt : std::expm1(aT) / a;
+    return std::make_tuple(Ad, EMat<1, INPUTS>(Bc * gamma));
+}
+
+/**
+ * Discretizes a small system with a truncated Taylor series and scaling and
+ * squaring, working on A alone instead of the augmented matrix.
+ *
+ * With X = AT / 2ˢ, the series
+ *
+ *   φ₁(X) = I + X/2! + X²/3! + ... + Xⁿ/(n + 1)!
+ *
+ * gives e^X = I + Xφ₁(X) and the integral Γ = ∫₀ᵀᐟ²ˢ e^(Aτ) dτ = (T / 2ˢ)φ₁(X)
+ * from one Horner chain. Each squaring doubles the interval:
+ *
+ *   Γ(2h) = (I + e^(Ah)) Γ(h)
+ *   e^(2Ah) = e^(Ah)²
+ *
+ * and finally Ad = e^(AT), Bd = ΓB.
+ *
+ * s is picked so ‖X‖₁ ≤ 1/2 and the series is cut off once the next term's
+ * bound ‖X‖₁ⁿ⁺¹/(n + 1)! is below 2⁻⁵³, so the truncation error of each
+ * scaled exponential is under one ulp relative to ‖e^X‖ ≥ e^(-1/2). Squaring
+ * amplifies that by at most 2ˢ, the same as the Padé path.
+ */
+template <int STATES, int INPUTS>
+std::tuple<EMat<STATES, STATES>, EMat<STATES, INPUTS>> discretize_AB_taylor(const EMat<STATES, STATES> &Ac, const EMat<STATES, INPUTS> &Bc, const double &dt) {
+    using StateMatrix = EMat<STATES, STATES>;
+    static constexpr double EPSILON = 1.1102230246251565e-16; // 2⁻⁵³
+    static constexpr int MAX_TERMS = 30;
+
+    const double norm = (Ac * dt).cwiseAbs().colwise().sum().maxCoeff();
+    int squarings = 0;
+    double theta = norm;
+    while (theta > 0.5) {
+        theta *= 0.5;
+        squarings++;
+    }
+    const double h = std::ldexp(dt, -squarings);
+    const StateMatrix X = Ac * h;
+
+    // Smallest n with θⁿ⁺¹/(n + 1)! below ε
+    int n = 0;
+    double bound = theta;
+    while (bound > EPSILON && n < MAX_TERMS) {
+        n++;
+        bound *= theta / (n + 1);
+    }
+
+    // Horner: φ₁ = I + X/2 (I + X/3 (I + ... (I + X/(n + 1))))
+    StateMatrix phi1 = StateMatrix::Identity();
+    for (int k = n; k >= 1; k--) {
+        phi1 = StateMatrix::Identity() + X * phi1 / (k + 1);
+    }
+
+    StateMatrix E = StateMatrix::Identity() + X * phi1;
+    StateMatrix gamma = phi1 * h;
+    for (int i = 0; i < squarings; i++) {
+        gamma = (StateMatrix::Identity() + E) * gamma;
+        E = E * E;
+    }
+
+    return std::make_tuple(E, EMat<STATES, INPUTS>(gamma * Bc));
+}
+
+/// Largest state dimension discretize_AB uses the Taylor kernel for
+#define DISCRETIZATION_TAYLOR_MAX_STATES 8
+
+/**
+ * Discretizes the continuous system and input matrices (A and B) over the
+ * timestep dt in seconds.
+ *
+ * The kernel is chosen at compile time: closed form for one state, the
+ * Taylor kernel for up to DISCRETIZATION_TAYLOR_MAX_STATES states (this
+ * covers every drive plant) and Eigen's Padé matrix exponential otherwise.
+ * 
+ * @tparam STATES Dimension of the state matrix.
+ * @tparam INPUTS Dimension of the input matrix.
+ * 
+ * @param Ac The continuous state matrix A.
+ * @param Bc The continuous input matrix B.
+ * @param dt The timestep in seconds.
+ */
+template <int STATES, int INPUTS>
+std::tuple<EMat<STATES, STATES>, EMat<STATES, INPUTS>> discretize_AB(const EMat<STATES, STATES> &Ac, const EMat<STATES, INPUTS> &Bc, const double &dt) {
+    if constexpr (STATES == 1) {
+        return discretize_AB_scalar<INPUTS>(Ac, Bc, dt);
+    } else if constexpr (STATES <= DISCRETIZATION_TAYLOR_MAX_STATES) {
+        return discretize_AB_taylor<STATES, INPUTS>(Ac, Bc, dt);
+    } else {
+        return discretize_AB_pade<STATES, INPUTS>(Ac, Bc, dt);
+    }
+}
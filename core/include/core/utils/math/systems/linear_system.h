@@ -37,12 +37,12 @@ class LinearSystem {
     /**
      * Returns the continuous system matrix A.
      */
-    MatrixA A() { return m_Ac; }
+    MatrixA A() const { return m_Ac; }
 
     /**
      * Returns the continuous input matrix B.
      */
-    MatrixB B() { return m_Bc; }
+    MatrixB B() const { return m_Bc; }
 
     /**
      * Returns a tuple of A and B after being discretized.
@@ -52,12 +52,12 @@ class LinearSystem {
     /**
      * Returns the output matrix C.
      */
-    MatrixC C() { return m_C; }
+    MatrixC C() const { return m_C; }
 
     /**
      * Returns the feedthrough matrix D.
      */
-    MatrixD D() { return m_D; }
+    MatrixD D() const { return m_D; }
 
     /**
      * Computes the new state vector given the previous state vector, an input
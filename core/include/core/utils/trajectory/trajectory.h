@@ -90,14 +90,77 @@ class Trajectory {
       t,
       [](const State &a, const Time &b) { return a.t < b; });
 
-    auto prev_sample = sample - 1;
+    return interpolate_segment(sample - m_states.cbegin(), t);
+  }
+
+  /**
+   * Samples a trajectory at (mostly) increasing times without searching the
+   * whole trajectory every call. It remembers the segment it last sampled
+   * from, so stepping forward a control period at a time is amortized O(1)
+   * no matter how many states the trajectory has. Seeking backwards or far
+   * ahead falls back to a binary search.
+   *
+   * Returns exactly what Trajectory::sample would for the same time. The
+   * trajectory must outlive the sampler.
+   */
+  class Sampler {
+   public:
+    Sampler() = default;
+
+    explicit Sampler(const Trajectory &trajectory) : m_trajectory(&trajectory) {}
+
+    State sample(Time t) {
+      if (m_trajectory == nullptr || m_trajectory->m_states.empty()) {
+        return State{};
+      }
 
-    if (abs(sample->t - prev_sample->t) < 1E-9_s) {
-      return *sample;
+      const std::vector<State> &states = m_trajectory->m_states;
+      if (t <= states.front().t) {
+        return states.front();
+      }
+      if (t >= m_trajectory->m_total_time) {
+        return states.back();
+      }
+
+      // Find the first state at or after t, same as the lower_bound in Trajectory::sample
+      if (m_index >= states.size() || t <= states[m_index - 1].t) {
+        m_index = search(1, m_index < states.size() ? m_index : states.size(), t);
+      } else {
+        size_t steps = 0;
+        while (states[m_index].t < t && steps < kMaxLinearSteps) {
+          ++m_index;
+          ++steps;
+        }
+        if (states[m_index].t < t) {
+          m_index = search(m_index + 1, states.size(), t);
+        }
+      }
+
+      return m_trajectory->interpolate_segment(m_index, t);
     }
 
-    return prev_sample->interpolate(*sample, ((t - prev_sample->t) / (sample->t - prev_sample->t)).value());
-  }
+    /**
+     * Forget the cached segment, the next sample starts from the beginning.
+     */
+    void reset() { m_index = 1; }
+
+   private:
+    static constexpr size_t kMaxLinearSteps = 8;
+
+    size_t search(size_t first, size_t last, Time t) const {
+      return std::lower_bound(
+               m_trajectory->m_states.cbegin() + first,
+               m_trajectory->m_states.cbegin() + last,
+               t,
+               [](const State &a, const Time &b) { return a.t < b; }) -
+             m_trajectory->m_states.cbegin();
+    }
+
+    const Trajectory *m_trajectory = nullptr;
+    size_t m_index = 1;
+  };
+
+  Sampler sampler() const { return Sampler(*this); }
 
   Trajectory transform_by(const Transform2d &transform) const {
     if (m_states.empty()) {
@@ -149,6 +212,18 @@ class Trajectory {
   }
 
  private:
+  // Interpolates between m_states[index - 1] and m_states[index] at time t.
+  State interpolate_segment(size_t index, Time t) const {
+    const State &sample = m_states[index];
+    const State &prev_sample = m_states[index - 1];
+
+    if (abs(sample.t - prev_sample.t) < 1E-9_s) {
+      return sample;
+    }
+
+    return prev_sample.interpolate(sample, ((t - prev_sample.t) / (sample.t - prev_sample.t)).value());
+  }
+
   std::vector<State> m_states;
   Time m_total_time = 0_s;
 };
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "core/utils/controls/state_space/ltv_differential_drive_controller.h"
+#include "core/utils/controls/state_space/tank_drive_model.h"
+#include "core/utils/trajectory/trajectory.h"
+#include "vex.h"
+
+/**
+ * Prepares the next trajectory, and the follower gains for it, on a low
+ * priority task while the current command runs, so chained trajectory
+ * segments start without any dead time.
+ *
+ * Typical use:
+ *   TrajectoryPrefetch::Handle next = TrajectoryPrefetch::start(
+ *     [] { return loader_to_goal_1() + loader_to_goal_2(); }, drive_model, cfg);
+ *
+ *   CommandController cc{
+ *     drive_sys.FollowTrajectoryCmd(first, cfg),
+ *     drive_sys.FollowTrajectoryCmd(next, cfg), // only waits if the work is not done yet
+ *   };
+ *
+ * If a Branch takes the path without the follow command, the command is
+ * skipped and the handle cancelled, so the task stops at its next check and
+ * the follow command finishes immediately.
+ */
+class TrajectoryPrefetch {
+  public:
+    typedef std::shared_ptr<TrajectoryPrefetch> Handle;
+    typedef std::function<Trajectory()> Generator;
+    typedef std::shared_ptr<const LTVDifferentialDriveController::GainTable> TablePtr;
+
+    enum Status { PENDING, READY, CANCELLED };
+
+    /**
+     * Starts preparing a trajectory in the background.
+     *
+     * @param generator builds the trajectory, runs on the background task
+     * @param model the drive model the gains are looked up for. The plant is
+     * copied now, later gain changes do not affect this prefetch
+     * @param cfg the follower config the trajectory will be followed with
+     * @param priority priority of the background task, below the auton thread by default
+     */
+    static Handle start(
+      const Generator &generator,
+      const TankDriveModel &model,
+      const TankTrajectoryFollowerConfig &cfg,
+      int32_t priority = vex::thread::threadPrioritylow);
+
+    Status status() const { return (Status)status_.load(); }
+    bool ready() const { return status() == READY; }
+    bool cancelled() const { return status() == CANCELLED; }
+
+    /**
+     * Asks the background task to stop. The generator itself is not
+     * interrupted, the task just skips whatever comes after it.
+     */
+    void cancel();
+
+    /**
+     * Blocks until the work is done or cancelled.
+     *
+     * @return the trajectory, or NULL if the prefetch was cancelled
+     */
+    const Trajectory *wait() const;
+
+    /**
+     * The prepared trajectory. Only valid once ready() is true.
+     */
+    const Trajectory &trajectory() const { return trajectory_; }
+
+    /**
+     * The follower gains for the prepared trajectory. Only valid once ready() is true.
+     */
+    TablePtr gains() const { return gains_; }
+
+  private:
+    TrajectoryPrefetch(const Generator &generator, const TankDriveModel &model, const TankTrajectoryFollowerConfig &cfg);
+
+    static int background_task(void *arg);
+
+    Generator generator_;
+    TankDriveModel::Plant plant_;
+    Length trackwidth_;
+    TankTrajectoryFollowerConfig cfg_;
+
+    Trajectory trajectory_;
+    TablePtr gains_;
+
+    std::atomic<int> status_;
+    std::atomic<bool> cancel_requested_;
+};
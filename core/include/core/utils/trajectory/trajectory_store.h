@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "core/utils/math/spline/hermite_point.h"
+#include "core/utils/trajectory/trajectory.h"
+#include "core/utils/trajectory/trajectory_config.h"
+
+/**
+ * Keeps generated trajectories around so autonomous routines never run the
+ * generator inside the auton window.
+ *
+ * A trajectory is identified by a name and a fingerprint of its waypoints and
+ * config. The first time it is requested it is generated and written to the SD
+ * card as a flat table of Trajectory::State. Later requests (and later boots,
+ * as long as the waypoints and config are unchanged) just load the table.
+ *
+ * Call every routine's trajectories once from robot_init (pre auton) and the
+ * calls made in autonomous are a map lookup.
+ *
+ * The returned references stay valid for the lifetime of the program, so they
+ * are safe to hand to FollowTrajectoryCmd. That holds across tasks too: a
+ * stored trajectory is never moved or overwritten, even when the same name is
+ * requested again with different waypoints.
+ */
+class TrajectoryStore {
+  public:
+    /// Bump whenever the file layout or the generator output changes
+    static constexpr uint16_t FILE_VERSION = 1;
+
+    /**
+     * Returns the trajectory with this name, loading it from the SD card or
+     * generating it if the stored one is missing or stale.
+     *
+     * @param name unique name of the trajectory, used for the file name
+     * @param waypoints the waypoints to generate from
+     * @param config the config to generate with
+     */
+    static const Trajectory &
+    get(const std::string &name, const std::vector<HermitePoint> &waypoints, const TrajectoryConfig &config);
+
+    /**
+     * Fingerprints everything that goes into generating a trajectory.
+     *
+     * Constraints are opaque, so they are fingerprinted by evaluating them at a
+     * fixed set of probe states. Changing a constraint's parameters changes its
+     * output there, which changes the fingerprint.
+     */
+    static uint64_t fingerprint(const std::vector<HermitePoint> &waypoints, const TrajectoryConfig &config);
+
+    /**
+     * Writes a trajectory to the SD card.
+     *
+     * @return true if the whole file was written
+     */
+    static bool save_to_sd(const std::string &name, uint64_t fingerprint, const Trajectory &trajectory);
+
+    /**
+     * Reads a trajectory from the SD card if the stored one was generated from
+     * the same fingerprint.
+     *
+     * @return true if out was filled in
+     */
+    static bool load_from_sd(const std::string &name, uint64_t fingerprint, Trajectory &out);
+};
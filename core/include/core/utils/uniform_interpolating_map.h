@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "core/utils/math/eigen_interface.h"
+
+/**
+ * A drop in replacement for InterpolatingMap for keys sampled on a uniform
+ * grid, like a gain schedule built with a fixed velocity step.
+ *
+ * Pairs are kept sorted in two flat arrays instead of a tree. When the keys
+ * are evenly spaced, a lookup is a single index computation and one lerp. If
+ * the keys are not evenly spaced it falls back to a binary search over the
+ * flat key array, so it always returns the same values InterpolatingMap would.
+ *
+ * Inserting in ascending key order is O(1), anything else is O(n).
+ *
+ * @tparam KEY The type of the key. Must be convertible to double.
+ * @tparam VALUE The type of the value.
+ */
+template <typename KEY, typename VALUE> class UniformInterpolatingMap {
+  public:
+    using KeyVector = std::vector<KEY>;
+    using ValueVector = std::vector<VALUE, Eigen::aligned_allocator<VALUE>>;
+
+    /**
+     * Inserts a key value pair. Like InterpolatingMap, inserting an existing
+     * key does nothing.
+     *
+     * @param key The key.
+     * @param value The value.
+     */
+    void insert(const KEY &key, const VALUE &value) {
+        if (keys_.empty() || key > keys_.back()) {
+            keys_.push_back(key);
+            values_.push_back(value);
+            if (uniform_ && keys_.size() > 2) {
+                const double expected = static_cast<double>(keys_[1] - keys_[0]);
+                const double spacing = static_cast<double>(keys_[keys_.size() - 1] - keys_[keys_.size() - 2]);
+                uniform_ = std::abs(spacing - expected) <= kSpacingTolerance * std::abs(expected);
+            }
+        } else {
+            typename KeyVector::iterator pos = std::lower_bound(keys_.begin(), keys_.end(), key);
+            if (*pos == key) {
+                return;
+            }
+            values_.insert(values_.begin() + (pos - keys_.begin()), value);
+            keys_.insert(pos, key);
+            uniform_ = check_uniform();
+        }
+
+        if (keys_.size() >= 2) {
+            inv_step_ = 1.0 / static_cast<double>(keys_[1] - keys_[0]);
+        }
+    }
+
+    /**
+     * Obtains the value at the given key.
+     *
+     * If the key does not exactly match a pair in the map, it will interpolate
+     * between the preceding and following pairs. Keys outside the map return
+     * the first or last value.
+     *
+     * @param key The key.
+     *
+     * @return The value.
+     */
+    VALUE operator[](const KEY &key) const {
+        if (key <= keys_.front()) {
+            return values_.front();
+        }
+        if (key >= keys_.back()) {
+            return values_.back();
+        }
+
+        size_t lower;
+        if (uniform_) {
+            lower = static_cast<size_t>(static_cast<double>(key - keys_.front()) * inv_step_);
+            // Accumulated floating point error in the grid can put us one cell off
+            lower = std::min(lower, keys_.size() - 2);
+            if (key < keys_[lower]) {
+                --lower;
+            } else if (key >= keys_[lower + 1]) {
+                ++lower;
+            }
+        } else {
+            lower = (std::upper_bound(keys_.begin(), keys_.end(), key) - keys_.begin()) - 1;
+        }
+
+        // Linear interpolate between the values of the first and second.
+        const double delta = (key - keys_[lower]) / (keys_[lower + 1] - keys_[lower]);
+        return delta * values_[lower + 1] + (1.0 - delta) * values_[lower];
+    }
+
+    /**
+     * Clears the contents of the map.
+     */
+    void clear() {
+        keys_.clear();
+        values_.clear();
+        uniform_ = true;
+        inv_step_ = 0.0;
+    }
+
+    /**
+     * @return The number of key value pairs in the map.
+     */
+    size_t size() const { return keys_.size(); }
+
+    /**
+     * @return true if lookups take the constant time path.
+     */
+    bool is_uniform() const { return uniform_; }
+
+    /**
+     * The stored keys and values, in ascending key order.
+     */
+    const KeyVector &keys() const { return keys_; }
+    const ValueVector &values() const { return values_; }
+
+  private:
+    static constexpr double kSpacingTolerance = 1e-6;
+
+    bool check_uniform() const {
+        if (keys_.size() < 3) {
+            return true;
+        }
+        const double expected = static_cast<double>(keys_[1] - keys_[0]);
+        for (size_t i = 2; i < keys_.size(); ++i) {
+            const double spacing = static_cast<double>(keys_[i] - keys_[i - 1]);
+            if (std::abs(spacing - expected) > kSpacingTolerance * std::abs(expected)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    KeyVector keys_;
+    ValueVector values_;
+    bool uniform_ = true;
+    double inv_step_ = 0.0;
+};
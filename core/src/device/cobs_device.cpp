@@ -1,6 +1,14 @@
 #include "core/device/cobs_device.h"
 
-COBSSerialDevice::COBSSerialDevice(int32_t port, int32_t baud) : port(port) {
+constexpr size_t COBSSerialDevice::RX_CHUNK_SIZE;
+constexpr size_t COBSSerialDevice::RX_SLOT_COUNT;
+constexpr size_t COBSSerialDevice::RX_SLOT_RESERVE;
+
+COBSSerialDevice::COBSSerialDevice(int32_t port, int32_t baud, uint32_t expected_packet_hz)
+    : port(port), rx_listener(SerialIOService::instance().listen(port, expected_packet_hz)) {
+    for (std::vector<uint8_t> &slot : rx_slots) {
+        slot.reserve(RX_SLOT_RESERVE);
+    }
     vexGenericSerialEnable(port, 0);
     vexGenericSerialBaudrate(port, baud);
 }
@@ -15,7 +23,18 @@ void COBSSerialDevice::hexdump(const uint8_t *data, size_t len) {
     fflush(stdout);
 }
 
-COBSSerialDevice::Packet COBSSerialDevice::get_last_decoded_packet() { return last_decoded_packet; }
+COBSSerialDevice::Packet COBSSerialDevice::get_last_decoded_packet() {
+    PacketView view = last_packet();
+    return Packet(view.begin(), view.end());
+}
+
+COBSSerialDevice::PacketView COBSSerialDevice::last_packet() const {
+    if (!have_decoded_packet) {
+        return PacketView{NULL, 0};
+    }
+    const std::vector<uint8_t> &slot = rx_slots[(assembling_slot + RX_SLOT_COUNT - 1) % RX_SLOT_COUNT];
+    return PacketView{slot.data(), slot.size()};
+}
 
 int COBSSerialDevice::send_cobs_packet_blocking(const uint8_t *data, size_t size, bool leading_delimeter) {
     serial_access_mut.lock();
@@ -57,37 +76,75 @@ int COBSSerialDevice::send_cobs_packet_blocking(const uint8_t *data, size_t size
 }
 bool COBSSerialDevice::poll_incoming_data_once() {
     while (true) {
-        int toRead = vexGenericSerialReceiveAvail(port);
-        if (toRead <= 0) {
-            return false;
-        }
-        int i = vexGenericSerialReadChar(port);
-        if (i < 0) {
-            return false;
+        // Only go back to VEX OS once everything from the last read is used up,
+        // a packet can finish part way through a chunk
+        if (incoming_head == incoming_len) {
+            int32_t avail = vexGenericSerialReceiveAvail(port);
+            if (avail <= 0) {
+                return false;
+            }
+            if (avail > (int32_t)RX_CHUNK_SIZE) {
+                avail = RX_CHUNK_SIZE;
+            }
+            int32_t got = vexGenericSerialReceive(port, incoming_buffer, avail);
+            if (got <= 0) {
+                return false;
+            }
+            incoming_head = 0;
+            incoming_len = got;
         }
-        bool finished = handle_incoming_byte((uint8_t)i);
+
+        size_t used = 0;
+        bool finished = handle_incoming_bytes(incoming_buffer + incoming_head, incoming_len - incoming_head, used);
+        incoming_head += used;
         if (finished) {
-            return finished;
+            return true;
         }
     }
     return false;
 }
 
 bool COBSSerialDevice::handle_incoming_byte(uint8_t b) {
-    if (b == 0) {
-        if (incoming_wire_packet.size() == 0) {
-            // got delimeter but had no packet, just reading delimeters
+    size_t used = 0;
+    return handle_incoming_bytes(&b, 1, used);
+}
+
+bool COBSSerialDevice::handle_incoming_bytes(const uint8_t *data, size_t len, size_t &used) {
+    used = 0;
+    while (used < len) {
+        const uint8_t *start = data + used;
+        const uint8_t *delim = (const uint8_t *)memchr(start, 0, len - used);
+        const size_t run = delim ? (size_t)(delim - start) : len - used;
+
+        std::vector<uint8_t> &slot = rx_slots[assembling_slot];
+        slot.insert(slot.end(), start, start + run);
+        used += run;
+
+        if (delim == NULL) {
             return false;
-        } else {
-            cobs_decode(incoming_wire_packet, last_decoded_packet);
-            incoming_wire_packet.clear();
+        }
+        used++; // the delimeter
+        if (finish_incoming_packet()) {
             return true;
         }
-    } else {
-        incoming_wire_packet.push_back(b);
+    }
+    return false;
+}
+
+bool COBSSerialDevice::finish_incoming_packet() {
+    std::vector<uint8_t> &slot = rx_slots[assembling_slot];
+    if (slot.size() == 0) {
+        // got delimeter but had no packet, just reading delimeters
         return false;
     }
+    slot.resize(cobs_decode_in_place(slot.data(), slot.size()));
+
+    assembling_slot = (assembling_slot + 1) % RX_SLOT_COUNT;
+    rx_slots[assembling_slot].clear();
+    have_decoded_packet = true;
+    return true;
 }
+
 int COBSSerialDevice::receive_cobs_packet_blocking(uint8_t *data, size_t max_size, uint32_t timeout_us) {
     serial_access_mut.lock();
     size_t start_time = vexSystemHighResTimeGet();
@@ -102,19 +159,19 @@ int COBSSerialDevice::receive_cobs_packet_blocking(uint8_t *data, size_t max_siz
         if (got_packet) {
             break;
         }
-        vex::this_thread::yield();
-    }
-
-    for (size_t index = 0; index < last_decoded_packet.size(); index++) {
-        if (index >= max_size) {
-            serial_access_mut.unlock();
-            return max_size;
+        uint32_t wait_ms = SerialIOService::DEFAULT_MAX_LATENCY_MS;
+        if (timeout_us != 0 && (timeout_us - elapsed) / 1000 < wait_ms) {
+            wait_ms = (timeout_us - elapsed) / 1000 + 1;
         }
-        data[index] = last_decoded_packet[index];
+        wait_for_data(wait_ms);
     }
 
+    PacketView packet = last_packet();
+    size_t to_copy = packet.size < max_size ? packet.size : max_size;
+    memcpy(data, packet.data, to_copy);
+
     serial_access_mut.unlock();
-    return last_decoded_packet.size();
+    return to_copy;
 }
 
 void COBSSerialDevice::cobs_encode(const Packet &in, WirePacket &out, bool add_start_delimeter) {
@@ -165,23 +222,28 @@ void COBSSerialDevice::cobs_encode(const Packet &in, WirePacket &out, bool add_s
 }
 
 void COBSSerialDevice::cobs_decode(const WirePacket &in, Packet &out) {
-    out.clear();
-    if (in.size() == 0) {
+    out.assign(in.begin(), in.end());
+    if (out.size() == 0) {
         return;
     }
+    out.resize(cobs_decode_in_place(out.data(), out.size()));
+}
 
-    out.resize(in.size() + in.size() / 254);
+size_t COBSSerialDevice::cobs_decode_in_place(uint8_t *data, size_t len) {
+    // The write head never passes the read head: code bytes are dropped and
+    // each one is replaced by at most one zero
     uint8_t code = 0xff;
     uint8_t left_in_block = 0;
     size_t write_head = 0;
-    for (const uint8_t byte : in) {
+    for (size_t read_head = 0; read_head < len; read_head++) {
+        const uint8_t byte = data[read_head];
         if (left_in_block) {
-            out[write_head] = byte;
+            data[write_head] = byte;
             write_head++;
         } else {
             left_in_block = byte;
             if (left_in_block != 0 && (code != 0xff)) {
-                out[write_head] = 0;
+                data[write_head] = 0;
                 write_head++;
             }
             code = left_in_block;
@@ -192,7 +254,5 @@ void COBSSerialDevice::cobs_decode(const WirePacket &in, Packet &out) {
         }
         left_in_block--;
     }
-    out.resize(write_head);
-
-    return;
+    return write_head;
 }
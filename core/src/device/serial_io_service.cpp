@@ -0,0 +1,171 @@
+#include "core/device/serial_io_service.h"
+
+#include <stdio.h>
+
+constexpr size_t SerialIOService::MAX_LISTENERS;
+constexpr uint32_t SerialIOService::DEFAULT_MAX_LATENCY_MS;
+constexpr int32_t SerialIOService::RX_HIGH_WATER;
+
+SerialIOService::Listener::Listener(int32_t port, uint32_t active_interval_ms, uint32_t max_interval_ms)
+    : port(port), active_interval_ms(active_interval_ms), max_interval_ms(max_interval_ms),
+      interval_ms(active_interval_ms), next_poll_ms(0), last_data_ms(0), events(0), seen_events(0), polled(false),
+      sleeper(nullptr),
+      wake_at_ms(0), sleep_events(0), sleeping(false) {}
+
+bool SerialIOService::Listener::wait(uint32_t timeout_ms, vex::task *self) {
+    SerialIOService &service = SerialIOService::instance();
+    service.start();
+
+    const uint32_t deadline_ms = vexSystemTimeGet() + timeout_ms;
+    while (true) {
+        uint32_t now_events = events.load(std::memory_order_acquire);
+        if (now_events != seen_events) {
+            seen_events = now_events;
+            return true;
+        }
+        const int32_t left_ms = (int32_t)(deadline_ms - vexSystemTimeGet());
+        if (left_ms <= 0) {
+            return false;
+        }
+
+        if (self != nullptr && polled) {
+            sleeper = self;
+            wake_at_ms = deadline_ms;
+            sleep_events = now_events;
+            // published before reading next_pass_ms, while the service publishes next_pass_ms before looking for
+            // sleepers. Either we see when it comes by next or it sees our deadline
+            sleeping.store(true);
+            if ((int32_t)(service.next_pass_ms.load() - deadline_ms) <= 0) {
+                // the service passes by before the deadline, so it resumes us by then at the latest.
+                // A notify() between the events check and here would have found us awake
+                if (events.load(std::memory_order_acquire) == now_events) {
+                    self->suspend();
+                }
+                sleeping.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            sleeping.store(false, std::memory_order_relaxed);
+        }
+        // nothing resumes us sooner than a timed sleep would, nobody signals between polls of the port anyway
+        vexDelay((uint32_t)left_ms < active_interval_ms ? (uint32_t)left_ms : active_interval_ms);
+    }
+}
+
+void SerialIOService::Listener::notify() {
+    events.fetch_add(1, std::memory_order_release);
+    if (sleeping.load(std::memory_order_acquire)) {
+        sleeper->resume();
+    }
+}
+
+SerialIOService &SerialIOService::instance() {
+    static SerialIOService service;
+    return service;
+}
+
+SerialIOService::SerialIOService() : num_listeners(0), started(false), next_pass_ms(0) {}
+
+SerialIOService::Listener *
+SerialIOService::listen(int32_t port, uint32_t expected_packet_hz, uint32_t max_latency_ms) {
+    if (max_latency_ms < 1) {
+        max_latency_ms = 1;
+    }
+    // poll twice per packet while they are coming in
+    uint32_t active_interval_ms = expected_packet_hz > 0 ? 500 / expected_packet_hz : max_latency_ms;
+    if (active_interval_ms < 1) {
+        active_interval_ms = 1;
+    } else if (active_interval_ms > max_latency_ms) {
+        active_interval_ms = max_latency_ms;
+    }
+
+    Listener *listener = new Listener(port, active_interval_ms, max_latency_ms);
+
+    listen_mut.lock();
+    size_t count = num_listeners.load(std::memory_order_relaxed);
+    if (count < MAX_LISTENERS) {
+        listener->polled = true;
+        listeners[count] = listener;
+        num_listeners.store(count + 1, std::memory_order_release);
+    } else {
+        printf("SerialIOService: too many listeners, port %d will not be polled\n", (int)port + 1);
+    }
+    listen_mut.unlock();
+
+    return listener;
+}
+
+void SerialIOService::start() {
+    if (started.load(std::memory_order_acquire) || started.exchange(true)) {
+        return;
+    }
+    service_task = vex::task(service_thread, (void *)this, vex::thread::threadPriorityHigh);
+}
+
+uint32_t SerialIOService::poll_once(uint32_t now_ms) {
+    uint32_t next_due_ms = DEFAULT_MAX_LATENCY_MS;
+    size_t count = num_listeners.load(std::memory_order_acquire);
+
+    for (size_t i = 0; i < count; i++) {
+        Listener &l = *listeners[i];
+        if ((int32_t)(now_ms - l.next_poll_ms) >= 0) {
+            int32_t avail = vexGenericSerialReceiveAvail(l.port);
+            if (avail > 0) {
+                l.notify();
+                l.last_data_ms = now_ms;
+                // the reader is falling behind, check back as soon as possible
+                l.interval_ms = avail >= RX_HIGH_WATER ? 1 : l.active_interval_ms;
+            } else if (l.interval_ms < l.max_interval_ms && now_ms - l.last_data_ms >= 4 * l.active_interval_ms) {
+                // a couple of packets missed, back off towards the max latency
+                l.interval_ms *= 2;
+                if (l.interval_ms > l.max_interval_ms) {
+                    l.interval_ms = l.max_interval_ms;
+                }
+            }
+            l.next_poll_ms = now_ms + l.interval_ms;
+        }
+
+        uint32_t due_ms = l.next_poll_ms - now_ms;
+        if (due_ms < next_due_ms) {
+            next_due_ms = due_ms;
+        }
+
+        if (l.sleeping.load(std::memory_order_acquire)) {
+            // also catches a resume that got to the reader before it had suspended itself. VEX OS only switches
+            // tasks when one sleeps or yields so that can't happen on the brain, but check back soon in case it did
+            if ((int32_t)(now_ms - l.wake_at_ms) >= 0 ||
+                l.events.load(std::memory_order_acquire) != l.sleep_events) {
+                l.sleeper->resume();
+                next_due_ms = 1;
+            } else if (l.wake_at_ms - now_ms < next_due_ms) {
+                next_due_ms = l.wake_at_ms - now_ms;
+            }
+        }
+    }
+    return next_due_ms;
+}
+
+uint32_t SerialIOService::trim_to_sleepers(uint32_t now_ms, uint32_t sleep_ms) {
+    size_t count = num_listeners.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        Listener &l = *listeners[i];
+        if (l.sleeping.load() && (int32_t)(l.wake_at_ms - now_ms) < (int32_t)sleep_ms) {
+            sleep_ms = (int32_t)(l.wake_at_ms - now_ms) > 1 ? l.wake_at_ms - now_ms : 1;
+        }
+    }
+    return sleep_ms;
+}
+
+int SerialIOService::service_thread(void *vself) {
+    SerialIOService &self = *(SerialIOService *)vself;
+    while (true) {
+        uint32_t now_ms = vexSystemTimeGet();
+        uint32_t sleep_ms = self.poll_once(now_ms);
+        if (sleep_ms < 1) {
+            sleep_ms = 1;
+        }
+        self.next_pass_ms.store(now_ms + sleep_ms);
+        sleep_ms = self.trim_to_sleepers(now_ms, sleep_ms);
+        vexDelay(sleep_ms);
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "core/device/vdb/protocol.hpp"
 #include "core/device/vdb/types.hpp"
 
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <functional>
@@ -16,6 +17,75 @@ namespace VDP {
  * @return the channel's id
  */
 ChannelID Channel::getID() const { return id; }
+/**
+ * adds a fixed size field after the ones already added
+ * @param value where the field's value is stored
+ * @param size how many bytes the value is
+ * @param type the field's schema type
+ * @param epsilon smallest change worth resending in a delta packet
+ */
+void ChannelLayout::add_field(void *value, size_t size, Type type, double epsilon) {
+    fields.push_back(Field{value, size, payload_size, type, epsilon});
+    payload_size += size;
+}
+/**
+ * forgets the compiled layout
+ */
+void ChannelLayout::clear() {
+    fields.clear();
+    payload_size = 0;
+    source = nullptr;
+}
+/**
+ * Compiles the channel's Part tree into a flat layout for sending
+ * @return true if every field is fixed size and the layout was compiled
+ */
+bool Channel::compile_layout() {
+    layout.clear();
+    if (data == nullptr || !data->add_to_layout(layout)) {
+        layout.clear();
+        return false;
+    }
+    layout.source = data.get();
+    // a new layout means the receiver needs every field again
+    delta_last_sent.assign(layout.payload_size, 0);
+    delta_sends_since_keyframe = DELTA_KEYFRAME_NOW;
+    return true;
+}
+/**
+ * Reads a delta data message into data, fields missing from the message keep their last value
+ * @param reader a reader positioned right after the channel id
+ * @return false if the channel can't be flattened or the message doesn't match its layout
+ */
+bool Channel::read_delta_message(PacketReader &reader) {
+    if (layout.source == nullptr || layout.source != data.get()) {
+        if (!compile_layout()) {
+            return false;
+        }
+    }
+    const size_t mask_bytes = (layout.fields.size() + 7) / 8;
+    // the checksum is still at the end of the packet
+    if (reader.remaining() < mask_bytes + 4) {
+        return false;
+    }
+    uint8_t mask[(MAX_CHANNEL_FIELDS + 7) / 8];
+    if (mask_bytes > sizeof(mask)) {
+        return false;
+    }
+    for (size_t i = 0; i < mask_bytes; i++) {
+        mask[i] = reader.get_byte();
+    }
+    for (size_t i = 0; i < layout.fields.size(); i++) {
+        if (mask[i / 8] & (1 << (i % 8))) {
+            const ChannelLayout::Field &field = layout.fields[i];
+            if (reader.remaining() < field.size + 4) {
+                return false;
+            }
+            reader.get_bytes(field.value, field.size);
+        }
+    }
+    return true;
+}
 /*
  * prints out the packet in individual bytes
  */
@@ -100,6 +170,8 @@ Part::~Part() {}
 std::string Part::get_name() const { return name; }
 
 void Part::response() {}
+
+bool Part::add_to_layout(ChannelLayout &) { return false; }
 /**
  *  @return a stringstream of the Part with the format "name: string"
  */
@@ -118,16 +190,18 @@ std::string Part::pretty_print_data() const {
     return ss.str();
 }
 /**
- * Defines a PacketReader to read a packet
+ * Defines a PacketReader to read a packet with a set start location for the packet
  * @param pac the packet to read
+ * @param start the start location for the reader to start reading from
  */
-PacketReader::PacketReader(Packet pac) : pac(std::move(pac)), read_head(0) {}
+PacketReader::PacketReader(const Packet &pac, size_t start) : data(pac.data()), len(pac.size()), read_head(start) {}
 /**
- * Defines a PacketReader to read a packet with a set start location for the packet
- * @param pac the packet to read
+ * Defines a PacketReader to read raw bytes
+ * @param data the bytes to read
+ * @param size how many bytes there are
  * @param start the start location for the reader to start reading from
  */
-PacketReader::PacketReader(Packet pac, size_t start) : pac(std::move(pac)), read_head(start) {}
+PacketReader::PacketReader(const uint8_t *data, size_t size, size_t start) : data(data), len(size), read_head(start) {}
 /**
  * checks a packets validility
  * @param packet the packet to check the validity of
@@ -162,10 +236,27 @@ VDP::PacketValidity validate_packet(const VDP::Packet &packet) {
  * @return the current byte the reader is on
  */
 uint8_t PacketReader::get_byte() {
-    const uint8_t b = pac[read_head];
+    if (read_head >= len) {
+        return 0;
+    }
+    const uint8_t b = data[read_head];
     read_head++;
     return b;
 }
+/**
+ * copies the next count bytes out of the packet
+ * @param out where to copy them
+ * @param count how many bytes to copy
+ * @return false if fewer than count bytes were left
+ */
+bool PacketReader::get_bytes(void *out, size_t count) {
+    if (count > remaining()) {
+        return false;
+    }
+    std::memcpy(out, data + read_head, count);
+    read_head += count;
+    return true;
+}
 /**
  * @return the current type the reader is on
  */
@@ -177,15 +268,14 @@ Type PacketReader::get_type() {
  * @return the string the reader is at the start of
  */
 std::string PacketReader::get_string() {
-    std::string s;
-    // iterates through the string until it reaches a 0 (end of the string)
-    while (1) {
-        const uint8_t c = get_byte();
-        if (c == 0) {
-            break;
-        }
-        s.push_back((char)c);
-    }
+    // finds the 0 at the end of the string and takes everything before it at once
+    const size_t left = remaining();
+    const uint8_t *start = data + read_head;
+    const uint8_t *end = (const uint8_t *)memchr(start, 0, left);
+    const size_t count = end ? (size_t)(end - start) : left;
+
+    std::string s((const char *)start, count);
+    read_head += count + (end ? 1 : 0);
     return s;
 }
 
@@ -193,20 +283,76 @@ std::string PacketReader::get_string() {
  * creates a packet writer
  * @param scratch_space the packet for the writer to write to
  */
-PacketWriter::PacketWriter(VDP::Packet &scratch) : sofar(scratch) {}
+PacketWriter::PacketWriter(VDP::Packet &scratch)
+    : sofar(&scratch), buffer(nullptr), capacity(0), length(0), overflow(false) {}
+/**
+ * creates a packet writer over a fixed buffer
+ * @param buffer the buffer to write to
+ * @param capacity how many bytes fit in buffer
+ */
+PacketWriter::PacketWriter(uint8_t *buffer, size_t capacity)
+    : sofar(nullptr), buffer(buffer), capacity(capacity), length(0), overflow(false) {}
 /**
  * clears the packet the writer is writing to
  */
-void PacketWriter::clear() { sofar.clear(); }
+void PacketWriter::clear() {
+    // clear() keeps the vector's storage so a reused scratch packet doesn't allocate again
+    if (sofar) {
+        sofar->clear();
+    }
+    length = 0;
+    overflow = false;
+}
 /**
  * @return the size of the packet
  */
-size_t PacketWriter::size() { return sofar.size(); }
+size_t PacketWriter::size() const { return sofar ? sofar->size() : length; }
+/**
+ * @return the bytes written so far
+ */
+const uint8_t *PacketWriter::data() const { return sofar ? sofar->data() : buffer; }
 /**
  * writes a byte to the end of the packet
  * @param b the byte to write
  */
-void PacketWriter::write_byte(uint8_t b) { sofar.push_back(b); }
+void PacketWriter::write_byte(uint8_t b) { write_bytes(&b, 1); }
+/**
+ * writes raw bytes to the end of the packet
+ * @param bytes the bytes to write
+ * @param count how many bytes to write
+ */
+void PacketWriter::write_bytes(const void *bytes, size_t count) {
+    const uint8_t *b = (const uint8_t *)bytes;
+    if (sofar) {
+        sofar->insert(sofar->end(), b, b + count);
+        return;
+    }
+    if (length + count > capacity) {
+        overflow = true;
+        return;
+    }
+    std::memcpy(buffer + length, b, count);
+    length += count;
+}
+/**
+ * makes room for count bytes at the end of the packet to be filled in directly
+ * @param count how many bytes to make room for
+ * @return where to write them, nullptr if a fixed buffer is out of room
+ */
+uint8_t *PacketWriter::reserve(size_t count) {
+    if (sofar) {
+        const size_t at = sofar->size();
+        sofar->resize(at + count);
+        return sofar->data() + at;
+    }
+    if (length + count > capacity) {
+        overflow = true;
+        return nullptr;
+    }
+    uint8_t *at = buffer + length;
+    length += count;
+    return at;
+}
 /**
  * writes a VDP type to the packet in the form of a byte
  * @param t the VDP type to write to the packet
@@ -217,16 +363,29 @@ void PacketWriter::write_type(Type t) { write_byte((uint8_t)t); }
  * @param str the string to write to the packet
  */
 void PacketWriter::write_string(const std::string &str) {
-    // inserts a string into the end of the packet in bytes
-    sofar.insert(sofar.end(), str.begin(), str.end());
-    // adds a 0 byte after the string to signal the end of the string
-    sofar.push_back(0);
+    // writes the string and the 0 byte after it that signals the end of the string
+    write_bytes(str.c_str(), str.size() + 1);
 }
 
 /**
  * @return the packet the writer is writing to
  */
-const Packet &PacketWriter::get_packet() const { return sofar; }
+const Packet &PacketWriter::get_packet() const {
+    static const Packet no_packet;
+    if (!sofar) {
+        printf("PacketWriter: get_packet() on a fixed buffer writer, use data() and size()\n");
+        return no_packet;
+    }
+    return *sofar;
+}
+
+/**
+ * appends the CRC32 of everything written so far
+ */
+void PacketWriter::write_checksum() {
+    uint32_t crc = CRC32::calculate(data(), size());
+    write_number<uint32_t>(crc);
+}
 
 /**
  * writes a broadcast acknowledgement of a channel to the packet
@@ -242,8 +401,7 @@ void PacketWriter::write_channel_acknowledge(const Channel &chan) {
     write_number<ChannelID>(chan.getID());
 
     // creates and writes the Checksum to the packet
-    uint32_t crc = CRC32::calculate(sofar.data(), sofar.size());
-    write_number<uint32_t>(crc);
+    write_checksum();
 }
 /**
  * writes a broadcast of a channel schematic to the packet
@@ -261,8 +419,7 @@ void PacketWriter::write_channel_broadcast(const Channel &chan) {
     chan.data->write_schema(*this);
 
     // creates and writes the Checksum to the packet
-    uint32_t crc = CRC32::calculate(sofar.data(), sofar.size());
-    write_number<uint32_t>(crc);
+    write_checksum();
 }
 
 /**
@@ -278,13 +435,98 @@ void PacketWriter::write_data_message(const Channel &chan) {
     write_number<uint8_t>(header);
     write_number<ChannelID>(chan.getID());
 
-    // writes the data from the channel to the packet
-    chan.data->write_message(*this);
+    // writes the data from the channel to the packet. A compiled channel is
+    // copied field by field into space made once, otherwise walk the Part tree
+    const ChannelLayout &layout = chan.get_layout();
+    if (layout.source != nullptr && layout.source == chan.data.get()) {
+        uint8_t *payload = reserve(layout.payload_size);
+        if (payload != nullptr) {
+            for (const ChannelLayout::Field &field : layout.fields) {
+                std::memcpy(payload + field.offset, field.value, field.size);
+            }
+        }
+    } else {
+        chan.data->write_message(*this);
+    }
 
     // creates and writes the Checksum to the packet
-    uint32_t crc = CRC32::calculate(sofar.data(), sofar.size());
-    // printf("data checksum: %08lx\n", crc);
-    write_number<uint32_t>(crc);
+    write_checksum();
+}
+
+/**
+ * @return true if a field moved further than its epsilon from the value last sent
+ */
+static bool delta_field_changed(const ChannelLayout::Field &field, const uint8_t *last_sent) {
+    if (field.epsilon > 0 && field.type == Type::Float) {
+        float now, before;
+        std::memcpy(&now, field.value, sizeof(now));
+        std::memcpy(&before, last_sent, sizeof(before));
+        // written so NaN counts as a change
+        return !(std::fabs(now - before) <= field.epsilon);
+    }
+    if (field.epsilon > 0 && field.type == Type::Double) {
+        double now, before;
+        std::memcpy(&now, field.value, sizeof(now));
+        std::memcpy(&before, last_sent, sizeof(before));
+        return !(std::fabs(now - before) <= field.epsilon);
+    }
+    return std::memcmp(field.value, last_sent, field.size) != 0;
+}
+
+/**
+ * writes only the fields of a channel that changed since it was last sent
+ * @param chan the Channel to write the data from
+ * @param keyframe_interval how many delta messages may follow one full message
+ */
+void PacketWriter::write_delta_message(Channel &chan, uint32_t keyframe_interval) {
+    const ChannelLayout &layout = chan.layout;
+    const bool compiled = layout.source != nullptr && layout.source == chan.data.get() &&
+                          chan.delta_last_sent.size() == layout.payload_size;
+    if (!compiled || layout.fields.size() > MAX_CHANNEL_FIELDS) {
+        write_data_message(chan);
+        return;
+    }
+
+    // keyframe: a normal full message, and everything in it counts as sent
+    if (chan.delta_sends_since_keyframe >= keyframe_interval) {
+        write_data_message(chan);
+        for (const ChannelLayout::Field &field : layout.fields) {
+            std::memcpy(&chan.delta_last_sent[field.offset], field.value, field.size);
+        }
+        chan.delta_sends_since_keyframe = 0;
+        return;
+    }
+
+    clear();
+    const uint8_t header = make_header_byte(PacketHeader{PacketType::Data, PacketFunction::Send, true});
+    write_number<uint8_t>(header);
+    write_number<ChannelID>(chan.getID());
+
+    // the bitmask goes before the values, so fill it in after they are written
+    const size_t mask_bytes = (layout.fields.size() + 7) / 8;
+    const size_t mask_at = size();
+    if (reserve(mask_bytes) == nullptr) {
+        return;
+    }
+
+    uint8_t changed[(MAX_CHANNEL_FIELDS + 7) / 8] = {0};
+    for (size_t i = 0; i < layout.fields.size(); i++) {
+        const ChannelLayout::Field &field = layout.fields[i];
+        uint8_t *last_sent = &chan.delta_last_sent[field.offset];
+        if (delta_field_changed(field, last_sent)) {
+            changed[i / 8] |= (uint8_t)(1 << (i % 8));
+            write_bytes(field.value, field.size);
+            std::memcpy(last_sent, field.value, field.size);
+        }
+    }
+    // writing the values may have moved a growing packet, so find the mask again
+    if (!overflowed()) {
+        std::memcpy((uint8_t *)data() + mask_at, changed, mask_bytes);
+    }
+    chan.delta_sends_since_keyframe++;
+
+    // creates and writes the Checksum to the packet
+    write_checksum();
 }
 
 /**
@@ -298,8 +540,7 @@ void PacketWriter::write_request() {
     // writes the header byte and channel id to the packet
     write_number<uint8_t>(header);
     // creates and writes the Checksum to the packet
-    uint32_t crc = CRC32::calculate(sofar.data(), sofar.size());
-    write_number<uint32_t>(crc);
+    write_checksum();
 }
 /**
  * writes a response packet to the brain
@@ -321,8 +562,7 @@ void PacketWriter::write_response(std::deque<Channel> &response_queue) {
   response_queue.pop_front();
 
   // creates and writes the Checksum to the packet
-  uint32_t crc = CRC32::calculate(sofar.data(), sofar.size());
-  write_number<uint32_t>(crc);
+  write_checksum();
 }
 
 /**
@@ -376,7 +616,7 @@ static constexpr auto PACKET_TYPE_BIT_MASK = 0b10000000;
 static constexpr auto PACKET_FUNCTION_BIT_MASK = 0b01100000;
 
 uint8_t make_header_byte(PacketHeader head) {
-  return (uint8_t)head.type | (uint8_t)head.func;
+  return (uint8_t)head.type | (uint8_t)head.func | (head.delta ? PACKET_DELTA_BIT_MASK : 0);
 }
 
 PacketHeader decode_header_byte(uint8_t hb) {
@@ -384,7 +624,7 @@ PacketHeader decode_header_byte(uint8_t hb) {
   const PacketFunction func =
       (PacketFunction)(hb & PACKET_FUNCTION_BIT_MASK);
 
-  return {pt, func};
+  return {pt, func, (hb & PACKET_DELTA_BIT_MASK) != 0};
 }
 /**
  * Decodes the broadcast in a packet
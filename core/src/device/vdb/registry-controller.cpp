@@ -4,6 +4,12 @@
 
 namespace VDP {
 
+constexpr uint32_t RegistryController::DEFAULT_KEYFRAME_INTERVAL;
+constexpr uint8_t RegistryController::BROADCAST_TRIES_PER;
+constexpr float RegistryController::LINK_HEADROOM;
+constexpr uint32_t RegistryController::MAX_SCHEDULER_SLEEP_MS;
+constexpr uint32_t RegistryController::BACKLOG_HIGH_WATER;
+
 /**
  * creates a device registry for sending data over the device
  * @param device the device to send data to
@@ -68,7 +74,15 @@ void RegistryController::take_packet(const Packet &pac) {
         const ChannelID id = reader.get_number<ChannelID>();
         if (id >= channels.size()) {
             printf("VDB-Controller: Recieved ack for unknown channel %d\n", id);
+            return;
         }
+        if (!channels[id].acked) {
+            VDPTracef(
+              "Controller: Acked channel %d after %d ms on attempt %d", id,
+              (int)(VDB::time_ms() - channels[id].broadcast_ms), (int)channels[id].broadcast_tries
+            );
+        }
+        // send_data streams this channel from now on, whatever the others are doing
         channels[id].acked = true;
     }
 }
@@ -104,7 +118,6 @@ ChannelID RegistryController::open_channel(PartPtr &for_data) {
  * @param data the Part Pointer for the channel to hold and send to the device
  */
 bool RegistryController::send_data(ChannelID id) {
-    channels[id].data->fetch();
     if (timer.time() > rec_switch_time) {
         rec_mode = !rec_mode;
         timer.reset();
@@ -118,97 +131,399 @@ bool RegistryController::send_data(ChannelID id) {
         return device->send_packet(writ.get_packet());
     }
     // checks if the channel is actually stored in the Registry
-    if (id > channels.size()) {
+    if (id >= channels.size()) {
         printf("VDB-Controller: Channel with ID %d doesn't exist yet\n", (int)id);
         return false;
     }
     // checks if the channel has been acknowledged yet
     if (!channels[id].acked) {
-        printf("VDB-Controller: Channel %d has not yet been negotiated. Dropping packet\n", (int)id);
+        // normal while negotiation is still running, so keep it out of the log
+        VDPDebugf("VDB-Controller: Channel %d has not yet been negotiated. Dropping packet", (int)id);
         return false;
     }
-    // if it has been acknowledged write the channel's data to a packet and send it to the device
-    VDP::Packet scratch;
-    PacketWriter writ{scratch};
+    // if it has been acknowledged write the channel's data to its scratch packet and send it to the device.
+    // The scheduler writes the same scratch packet and delta state, so this waits out a scheduler pass
+    schedule_mut.lock();
+    channels[id].data->fetch();
+    const bool sent = send_channel(channels[id]);
+    schedule_mut.unlock();
+    return sent;
+}
 
-    writ.write_data_message(channels[id]);
-    VDP::Packet pac = writ.get_packet();
+/**
+ * Writes a channel's data (or the changes to it) and sends it
+ * @return whether the device took the packet
+ */
+bool RegistryController::send_channel(Channel &chan) {
+    // The scratch packet is reused every send so it stops allocating once it has grown to fit
+    PacketWriter writ{chan.packet_scratch_space};
+
+    if (delta_encoding) {
+        writ.write_delta_message(chan, keyframe_interval);
+    } else {
+        writ.write_data_message(chan);
+    }
 
-    return device->send_packet(pac);
+    if (!device->send_packet(writ.get_packet())) {
+        // the other side never saw what changed in this one
+        chan.request_keyframe();
+        return false;
+    }
+    return true;
 }
 
 /**
- * sends channel schematics to the Registry device and checks for ackowledgements
+ * Sends only the fields that changed since the last send, with a full keyframe every keyframe_interval sends
+ * @param enabled whether send_data sends delta packets
+ * @param keyframe_interval how many delta packets may follow one full packet
+ */
+void RegistryController::set_delta_encoding(bool enabled, uint32_t keyframe_interval) {
+    schedule_mut.lock();
+    delta_encoding = enabled;
+    this->keyframe_interval = keyframe_interval;
+    for (Channel &chan : channels) {
+        chan.request_keyframe();
+    }
+    schedule_mut.unlock();
+}
+/**
+ * Broadcasts every channel that hasn't been acked yet all at once and returns right away.
+ * The retry task takes it from there
+ */
+void RegistryController::start_negotiation() {
+    printf("Negotiating...\n");
+    negotiation_mut.lock();
+    const uint32_t now = VDB::time_ms();
+    for (Channel &chan : channels) {
+        if (chan.acked) {
+            continue;
+        }
+        // the schema is fixed from here on, so flatten it for send_data before the ack lets it stream
+        if (!chan.compile_layout()) {
+            VDPDebugf("Controller: chan id %d has variable size fields, sending it through its Part tree", chan.id);
+        }
+        chan.broadcast_tries = 0;
+        broadcast_channel(chan, now);
+    }
+    if (!negotiation_running.exchange(true)) {
+        negotiation_task = vex::task(negotiation_thread, (void *)this, vex::thread::threadPrioritylow);
+    }
+    negotiation_mut.unlock();
+}
+
+/**
+ * Sends the schema of one channel and counts the attempt
+ */
+void RegistryController::broadcast_channel(Channel &chan, uint32_t now) {
+    VDPDebugf("Controller: Negotiating chan id %d", chan.id);
+    PacketWriter writer{broadcast_scratch_space};
+    writer.write_channel_broadcast(chan);
+    device->send_packet(writer.get_packet());
+    chan.broadcast_ms = now;
+    chan.broadcast_tries++;
+}
+
+/**
+ * Rebroadcasts channels whose ack expired, and gives up on a channel one ack_ms after its last try
+ * @return true if some channel is still waiting on an ack
+ */
+bool RegistryController::retry_broadcasts(uint32_t now) {
+    bool waiting = false;
+    for (Channel &chan : channels) {
+        // a channel past BROADCAST_TRIES_PER has been given up on
+        if (chan.acked || chan.broadcast_tries > BROADCAST_TRIES_PER) {
+            continue;
+        }
+        if (now - chan.broadcast_ms <= ack_ms) {
+            waiting = true;
+            continue;
+        }
+        VDPWarnf("Controller: ack for chan id:%02x expired after %d msec", chan.id, (int)ack_ms);
+        if (chan.broadcast_tries == BROADCAST_TRIES_PER) {
+            VDPWarnf("Controller: Giving up on chan id:%02x after %d tries", chan.id, (int)BROADCAST_TRIES_PER);
+            chan.broadcast_tries++;
+            continue;
+        }
+        broadcast_channel(chan, now);
+        waiting = true;
+    }
+    return waiting;
+}
+
+/**
+ * Rebroadcasts the channels whose ack timed out until every channel is acked or out of retries
+ * @param self the RegistryController
+ */
+int RegistryController::negotiation_thread(void *vself) {
+    constexpr uint32_t RETRY_CHECK_MS = 5;
+    RegistryController &self = *(RegistryController *)vself;
+    while (true) {
+        self.negotiation_mut.lock();
+        const bool waiting = self.retry_broadcasts(VDB::time_ms());
+        if (!waiting) {
+            // under the lock so a start_negotiation() racing with this starts a new task
+            self.negotiation_running = false;
+        }
+        self.negotiation_mut.unlock();
+        if (!waiting) {
+            break;
+        }
+        VDB::delay_ms(RETRY_CHECK_MS);
+    }
+    return 0;
+}
+
+/**
+ * sends channel schematics to the Registry device and waits for all of the ackowledgements
  * @return whether or not all channel's were acknowledgements
  */
 bool RegistryController::negotiate() {
-    printf("Negotiating...\n");
-    bool acked_all = true;
-    int failed_acks = 0;
-
-    constexpr size_t BROADCAST_TRIES_PER = 3;
-    // negotiates with each channel however many times broadcast_tries_per is set to
-    for (size_t i = 0; i < channels.size(); i++) {
-        for (size_t j = 0; j < BROADCAST_TRIES_PER; j++) {
-            VDPDebugf("Controller: Negotiating chan id %d", i);
-            // writes the channel's data schematic to a packet
-            const Channel &chan = channels[i];
-            Packet scratch;
-            PacketWriter writer{scratch};
-            writer.write_channel_broadcast(chan);
-            VDP::Packet pac = writer.get_packet();
-
-            // sends the data schematic to the device
-            device->send_packet(pac);
-            needs_ack = true;
-            // waits 500ms for an acknowledgment of the packet
-            auto time = VDB::time_ms();
-            while (!chan.acked) {
-                auto now = VDB::time_ms();
-                if (now - time > ack_ms) {
-                    // timed out
-                    break;
-                }
-                VDB::delay_ms(5);
+    start_negotiation();
+    while (negotiating()) {
+        VDB::delay_ms(5);
+    }
+
+    int failed_channels = 0;
+    for (const Channel &chan : channels) {
+        if (!chan.acked) {
+            failed_channels++;
+        }
+    }
+    // print out how many channels never got acknowledged
+    if (failed_channels > 0) {
+        VDPWarnf("Controller: Failed to ack %d channels", failed_channels);
+    }
+    return failed_channels == 0;
+}
+
+/**
+ * Streams a channel at a fixed rate from the scheduler task instead of ad hoc send_data calls
+ * @param id the channel to schedule
+ * @param hz sends per second, 0 to stop scheduling it
+ */
+void RegistryController::set_channel_rate(ChannelID id, float hz) {
+    if (id >= channels.size()) {
+        printf("VDB-Controller: Can't schedule channel %d, it doesn't exist yet\n", (int)id);
+        return;
+    }
+    schedule_mut.lock();
+    if (schedule.size() <= id) {
+        schedule.resize(id + 1, ChannelSchedule{});
+    }
+    ChannelSchedule &sched = schedule[id];
+    sched.stats.requested_hz = hz > 0 ? hz : 0;
+    // the scheduler starts the clock once the channel is acked, periods spent negotiating aren't misses
+    sched.started = false;
+    schedule_mut.unlock();
+}
+
+/**
+ * Starts the task that sends scheduled channels and requests responses every rec_switch_time ms
+ */
+void RegistryController::start_scheduler() {
+    if (scheduler_running.exchange(true)) {
+        return;
+    }
+    const uint32_t now = VDB::time_ms();
+    last_refill_ms = now;
+    last_feedback_ms = now;
+    window_start_ms = now;
+    last_request_ms = now;
+    scheduler_task = vex::task(scheduler_thread, (void *)this, vex::thread::threadPriorityNormal);
+}
+
+int RegistryController::scheduler_thread(void *vself) {
+    RegistryController &self = *(RegistryController *)vself;
+    while (true) {
+        uint32_t wait_ms = self.run_scheduler_once(VDB::time_ms());
+        if (wait_ms < 1) {
+            wait_ms = 1;
+        } else if (wait_ms > MAX_SCHEDULER_SLEEP_MS) {
+            wait_ms = MAX_SCHEDULER_SLEEP_MS;
+        }
+        VDB::delay_ms(wait_ms);
+    }
+    return 0;
+}
+
+/**
+ * Gives every scheduled channel the same share of its requested rate, as much as the link budget allows.
+ * The budget is the device's link rate, backed off while the device reports a backlog
+ */
+void RegistryController::update_rates(uint32_t now) {
+    if (now - last_feedback_ms >= 50) {
+        last_feedback_ms = now;
+        // packets piling up means the estimate is optimistic, recover slowly once the backlog clears
+        const uint32_t backlog = device->send_backlog();
+        if (backlog > BACKLOG_HIGH_WATER) {
+            link_scale = link_scale * 0.9f < 0.1f ? 0.1f : link_scale * 0.9f;
+        } else if (backlog == 0 && link_scale < 1) {
+            link_scale = link_scale + 0.02f > 1 ? 1 : link_scale + 0.02f;
+        }
+    }
+
+    const double budget = device->link_bytes_per_second() * LINK_HEADROOM * link_scale;
+    double demand = 0;
+    for (const ChannelSchedule &sched : schedule) {
+        demand += sched.stats.requested_hz * sched.packet_bytes;
+    }
+    // an unknown link rate isn't budgeted
+    const double share = budget > 0 && demand > budget ? budget / demand : 1.0;
+    for (ChannelSchedule &sched : schedule) {
+        sched.stats.effective_hz = (float)(sched.stats.requested_hz * share);
+    }
+}
+
+/**
+ * Sends the scheduled channels that are due and fit in the link budget, earliest deadline first
+ * @param now the current time in ms
+ * @return ms until something is due again
+ */
+uint32_t RegistryController::run_scheduler_once(uint32_t now) {
+    uint32_t next_due_ms = MAX_SCHEDULER_SLEEP_MS;
+
+    // the listener only sends its responses when asked, keep asking while it says more are queued
+    if (now - last_request_ms >= (uint32_t)rec_switch_time || responses_in_queue > 0) {
+        Packet request;
+        PacketWriter writ{request};
+        writ.write_request();
+        device->send_packet(writ.get_packet());
+        last_request_ms = now;
+        responses_in_queue = 0;
+    }
+
+    schedule_mut.lock();
+    update_rates(now);
+
+    const double budget = device->link_bytes_per_second() * LINK_HEADROOM * link_scale;
+    if (budget > 0) {
+        // at most 50ms worth of sending saved up, so a quiet period doesn't turn into a burst,
+        // but always enough for the biggest packet or it would never go out on a slow link
+        link_tokens += (now - last_refill_ms) * budget / 1000.0;
+        double burst = budget / 20.0;
+        for (const ChannelSchedule &sched : schedule) {
+            if (sched.packet_bytes > burst) {
+                burst = sched.packet_bytes;
+            }
+        }
+        if (link_tokens > burst) {
+            link_tokens = burst;
+        }
+    }
+    last_refill_ms = now;
+
+    while (true) {
+        // earliest deadline among the due channels
+        ChannelSchedule *next = nullptr;
+        ChannelID next_id = 0;
+        for (size_t id = 0; id < schedule.size(); id++) {
+            ChannelSchedule &sched = schedule[id];
+            if (sched.stats.effective_hz <= 0 || !channels[id].acked) {
+                continue;
             }
-            // checks if the packet was acknowledged
-            if (chan.acked == true) {
-                // if the channel was acknowledged, move on to the next channel
-                VDPTracef(
-                  "Controller: Acked channel %d after %d ms on attempt %d", chan.id, (int)(VDB::time_ms() - time),
-                  (int)j + 1
-                );
-                break;
-            } else {
-                // if the channel was not acknowledged add one to the failed acknowledgements counter and set acked_all
-                // to false then move on to the next channel
-                VDPWarnf("Controller: ack for chan id:%02x expired after %d msec", chan.id, (int)ack_ms);
-                failed_acks++;
-                if (j == BROADCAST_TRIES_PER - 1) {
-                    acked_all = false;
+            if (!sched.started) {
+                sched.deadline_ms = now;
+                sched.started = true;
+            }
+            if (sched.deadline_ms > now) {
+                const uint32_t due_ms = (uint32_t)(sched.deadline_ms - now);
+                if (due_ms < next_due_ms) {
+                    next_due_ms = due_ms;
                 }
+                continue;
+            }
+            if (next == nullptr || sched.deadline_ms < next->deadline_ms) {
+                next = &sched;
+                next_id = (ChannelID)id;
             }
         }
+        if (next == nullptr) {
+            break;
+        }
+        if (budget > 0 && link_tokens < next->packet_bytes) {
+            // the link is full, try again once it has drained enough for this one
+            const uint32_t refill_ms = (uint32_t)((next->packet_bytes - link_tokens) * 1000.0 / budget) + 1;
+            if (refill_ms < next_due_ms) {
+                next_due_ms = refill_ms;
+            }
+            break;
+        }
+
+        Channel &chan = channels[next_id];
+        chan.data->fetch();
+        if (send_channel(chan)) {
+            next->stats.sent++;
+            next->window_sent++;
+        } else {
+            next->stats.dropped++;
+        }
+        // what the device puts on the wire, COBS adds a byte per 254 and the delimiters
+        const uint32_t size = chan.packet_scratch_space.size();
+        next->packet_bytes = size + size / 254 + 2;
+        link_tokens -= next->packet_bytes;
+
+        const double period_ms = 1000.0 / next->stats.effective_hz;
+        next->deadline_ms += period_ms;
+        if (next->deadline_ms <= now) {
+            // whole periods went by without a send, skip them instead of bursting to catch up
+            const uint32_t missed = (uint32_t)((now - next->deadline_ms) / period_ms) + 1;
+            next->stats.missed_deadlines += missed;
+            next->deadline_ms += missed * period_ms;
+        }
     }
-    // print out how many times a channel failed to be acknowledged
-    if (failed_acks > 0) {
-        VDPWarnf("Controller: Failed to ack %d times", failed_acks);
+
+    if (now - window_start_ms >= 1000) {
+        for (ChannelSchedule &sched : schedule) {
+            sched.stats.achieved_hz = sched.window_sent * 1000.f / (now - window_start_ms);
+            sched.window_sent = 0;
+        }
+        window_start_ms = now;
     }
-    return acked_all;
+    schedule_mut.unlock();
 
-    // if (needs_ack && waiting_on_ack_timer.time(vex::timeUnits::msec) < ack_ms)
-    // { printf("Still waiting on ack"); vexDelay(ack_ms -
-    // waiting_on_ack_timer.time(vex::timeUnits::msec));
-    // }
+    return next_due_ms;
+}
+
+/**
+ * @param id the channel to report on
+ * @return the channel's scheduling counters, all zero if it was never scheduled
+ */
+RegistryController::ChannelStats RegistryController::get_channel_stats(ChannelID id) {
+    ChannelStats stats = {};
+    schedule_mut.lock();
+    if (id < schedule.size()) {
+        stats = schedule[id].stats;
+    }
+    schedule_mut.unlock();
+    return stats;
+}
 
-    // if (reg_type == Side::Controller) {
-    // PacketWriter writer;
-    // writer.write_channel_broadcast(chan);
-    // VDP::Packet pac = writer.get_packet();
-    //
-    // device->send_packet(pac);
-    // needs_ack = true;
-    // waiting_on_ack_timer.reset();
-    // }
+/**
+ * Opens a channel that reports how every scheduled channel is keeping up back to the host once a second.
+ * The fields read the counters while the scheduler holds schedule_mut, so they don't lock themselves
+ * @return the channel id of the report
+ */
+ChannelID RegistryController::open_scheduler_report() {
+    std::vector<PartPtr> entries;
+    for (size_t i = 0; i < schedule.size(); i++) {
+        const ChannelID id = (ChannelID)i;
+        if (schedule[id].stats.requested_hz <= 0) {
+            continue;
+        }
+        entries.push_back(PartPtr(new Record(
+          channels[id].data->get_name(),
+          std::vector<PartPtr>{
+            PartPtr(new Float("requested_hz", [this, id]() { return schedule[id].stats.requested_hz; })),
+            PartPtr(new Float("effective_hz", [this, id]() { return schedule[id].stats.effective_hz; })),
+            PartPtr(new Float("achieved_hz", [this, id]() { return schedule[id].stats.achieved_hz; })),
+            PartPtr(new Uint32("missed_deadlines", [this, id]() { return schedule[id].stats.missed_deadlines; })),
+            PartPtr(new Uint32("dropped", [this, id]() { return schedule[id].stats.dropped; })),
+          }
+        )));
+    }
+    PartPtr report = PartPtr(new Record("scheduler", entries));
+    ChannelID report_id = open_channel(report);
+    set_channel_rate(report_id, 1);
+    return report_id;
 }
 } // namespace VDP
@@ -75,6 +75,19 @@ void Record::read_data_from_message(PacketReader &reader) {
         f->read_data_from_message(reader);
     }
 }
+/**
+ * adds every field's data to a flat layout, in the order write_message writes them
+ * @param layout the layout to add to
+ * @return false if any field has no fixed size
+ */
+bool Record::add_to_layout(ChannelLayout &layout) {
+    for (const PartPtr &f : fields) {
+        if (!f->add_to_layout(layout)) {
+            return false;
+        }
+    }
+    return true;
+}
 /**
  * writes the Record as the
  */
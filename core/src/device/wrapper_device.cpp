@@ -5,6 +5,11 @@
 
 #include "core/device/wrapper_device.hpp"
 namespace VDB {
+
+constexpr std::size_t Device::CONTROL_QUEUE_SIZE;
+constexpr std::size_t Device::DATA_QUEUE_SIZE;
+constexpr std::size_t Device::OUT_SLOT_RESERVE;
+
 /**
  * delay for ms time
  * @param ms the ms to delay for
@@ -26,10 +31,8 @@ int Device::serial_thread(void *vself) {
     // loop for the thread
     while (true) {
         bool did_something = false;
-        // Lame replacement for blocking IO. We can't just wait and tell the
-        // scheduler to go work on something else while we wait for packets so
-        // instead, if we're getting nothing in and have nothing to send, block
-        // ourselves.
+        // If we're getting nothing in and have nothing to send, sleep until
+        // the serial service sees bytes on the port or send_packet wakes us.
 
         // Writing
         if (self.write_packet_if_avail()) {
@@ -37,13 +40,14 @@ int Device::serial_thread(void *vself) {
         }
         // Reading
         if (self.poll_incoming_data_once()) {
-            Packet decoded = {};
-            decoded = self.get_last_decoded_packet();
-            self.callback(decoded);
+            // reuses the same storage every packet instead of allocating a new one
+            PacketView view = self.last_packet();
+            self.decoded.assign(view.begin(), view.end());
+            self.callback(self.decoded);
             did_something = true;
         }
         if (!did_something) {
-            vexDelay(NO_ACTIVITY_DELAY);
+            self.wait_for_data(NO_ACTIVITY_DELAY, &self.serial_task);
         }
     }
     return 0;
@@ -53,41 +57,158 @@ int Device::serial_thread(void *vself) {
  * @param port the port the debug board is connected to
  * @param baud_rate the baud rate for the debug board to use
  */
-Device::Device(int32_t port, int32_t baud_rate) : COBSSerialDevice(port, baud_rate) {
+Device::Device(int32_t port, int32_t baud_rate) : COBSSerialDevice(port, baud_rate), baud_rate(baud_rate) {
     serial_task = vex::task(Device::serial_thread, (void *)this, vex::thread::threadPriorityHigh);
 }
 
 bool Device::send_packet(const VDP::Packet &packet) {
-    if (outbound_packets.size() >= MAX_OUT_QUEUE_SIZE) {
+    if (packet.size() == 0) {
+        return false;
+    }
+    OutboundLane &lane = lane_for(packet) == Lane::Control ? control_lane : data_lane;
+    if (!lane.push(packet)) {
         return false;
     }
-    outbound_packets.push_front(packet);
+    wake();
     return true;
 }
 
 /**
- * writes a packet to the device as soon as it is available
+ * Data and response packets are bulk telemetry, everything else keeps the link itself going
+ * @return the lane a packet is queued on, decided by its header
+ */
+Device::Lane Device::lane_for(const VDP::Packet &packet) {
+    const VDP::PacketHeader header = VDP::decode_header_byte(packet[0]);
+    if (header.type == VDP::PacketType::Data &&
+        (header.func == VDP::PacketFunction::Send || header.func == VDP::PacketFunction::Response)) {
+        return Lane::Data;
+    }
+    return Lane::Control;
+}
+
+/**
+ * @return bytes per second at the port's baud rate, 10 bits on the wire per byte
+ */
+uint32_t Device::link_bytes_per_second() const { return baud_rate > 0 ? (uint32_t)baud_rate / 10 : 0; }
+
+/**
+ * @return packets waiting in both outbound lanes
+ */
+uint32_t Device::send_backlog() const { return control_lane.stats().depth + data_lane.stats().depth; }
+
+/**
+ * @param lane the outbound lane to report on
+ * @return the lane's counters
+ */
+Device::QueueStats Device::get_queue_stats(Lane lane) const {
+    return lane == Lane::Control ? control_lane.stats() : data_lane.stats();
+}
+
+/**
+ * writes a packet to the device as soon as it is available, control packets first
  */
 bool Device::write_packet_if_avail() {
-    // packet to write to the device
-    WirePacket outbound_packet = {};
-    // lock the serial port
-    outbound_mutex.lock();
-    // check if we have a packet to write
-    if (outbound_packets.size() > 0) {
-        // of we do take the latest packet out of the vector of packets we have
-        outbound_packet = outbound_packets.back();
-        outbound_packets.pop_back();
+    OutboundLane *lane = &control_lane;
+    const WirePacket *outbound_packet = lane->peek();
+    if (outbound_packet == nullptr) {
+        lane = &data_lane;
+        outbound_packet = lane->peek();
     }
-    // unlock
-    outbound_mutex.unlock();
-    if (outbound_packet.size() == 0) {
+    if (outbound_packet == nullptr) {
         return false;
     }
-    send_cobs_packet_blocking(outbound_packet.data(), outbound_packet.size());
+    // sent straight out of the slot, it only goes back to the producers once it's on the wire
+    send_cobs_packet_blocking(outbound_packet->data(), outbound_packet->size());
+    lane->pop();
 
     return true;
 }
+
+/**
+ * @param capacity number of slots, a power of two
+ */
+Device::OutboundLane::OutboundLane(std::size_t capacity)
+    : slots(new Slot[capacity]), mask((uint32_t)capacity - 1), enqueue_pos(0), dequeue_pos(0), sent(0), dropped(0),
+      max_depth(0) {
+    for (std::size_t i = 0; i < capacity; i++) {
+        slots[i].sequence.store((uint32_t)i, std::memory_order_relaxed);
+        slots[i].packet.reserve(OUT_SLOT_RESERVE);
+    }
+}
+
+Device::OutboundLane::~OutboundLane() { delete[] slots; }
+
+/**
+ * copies a packet into the next free slot
+ * @return false if every slot is taken, the packet is dropped
+ */
+bool Device::OutboundLane::push(const VDP::Packet &packet) {
+    uint32_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+        slot = &slots[pos & mask];
+        const uint32_t seq = slot->sequence.load(std::memory_order_acquire);
+        const int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            // the slot is free this time around, claim it
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // the consumer hasn't freed this slot since last time around, the lane is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            // another producer claimed it first
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    // reuses the slot's storage, only allocates if this packet is bigger than any before it
+    slot->packet.assign(packet.begin(), packet.end());
+    // measured before publishing, the consumer can't get past this slot until then
+    const uint32_t depth = pos + 1 - dequeue_pos.load(std::memory_order_relaxed);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    uint32_t seen = max_depth.load(std::memory_order_relaxed);
+    while (depth > seen && !max_depth.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+/**
+ * @return the oldest packet, or nullptr if the lane is empty. It stays valid until pop()
+ */
+const Device::WirePacket *Device::OutboundLane::peek() {
+    const uint32_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    Slot &slot = slots[pos & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+        // empty, or the producer that claimed it is still copying
+        return nullptr;
+    }
+    return &slot.packet;
+}
+
+/**
+ * hands the slot returned by peek() back to the producers
+ */
+void Device::OutboundLane::pop() {
+    const uint32_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    slots[pos & mask].sequence.store(pos + mask + 1, std::memory_order_release);
+    dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+    sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+Device::QueueStats Device::OutboundLane::stats() const {
+    QueueStats stats;
+    stats.sent = sent.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    // dequeue_pos first, it never passes enqueue_pos
+    const uint32_t consumed = dequeue_pos.load(std::memory_order_acquire);
+    stats.depth = enqueue_pos.load(std::memory_order_acquire) - consumed;
+    stats.max_depth = max_depth.load(std::memory_order_relaxed);
+    return stats;
+}
+
 /**
  * defines a callback to a functions that calls when the register recieves data from the device
  * @param callback the callback function to call
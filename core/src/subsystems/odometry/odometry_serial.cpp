@@ -36,7 +36,8 @@ OdometrySerial::OdometrySerial(
   bool is_async, bool calc_vel_acc_on_brain, Pose2d initial_pose, Pose2d sensor_offset, int32_t port, int32_t baudrate
 )
     : OdometryBase(is_async), pose(Pose2d(0, 0, 0)),
-      pose_offset(Pose2d(0, 0, 0)), _port(port), calc_vel_acc_on_brain(calc_vel_acc_on_brain) {
+      pose_offset(Pose2d(0, 0, 0)), _port(port), rx_listener(SerialIOService::instance().listen(port, 100)),
+      calc_vel_acc_on_brain(calc_vel_acc_on_brain) {
     vexGenericSerialEnable(_port, 0);
     vexGenericSerialBaudrate(_port, baudrate);
     send_config(initial_pose, sensor_offset, calc_vel_acc_on_brain);
@@ -84,9 +85,25 @@ int OdometrySerial::receive_cobs_packet(uint32_t port, uint8_t *buffer, size_t b
     size_t index = 0;
 
     while (true) {
-        // wait for a byte (we read byte by byte into our own buffer rather than grabbing the whole packet all at once)
-        if (vexGenericSerialReceiveAvail(port) > 0) {
-            uint8_t character = vexGenericSerialReadChar(port);
+        // read whatever is waiting in one call rather than a call per byte, leftovers carry over to the next packet
+        if (rx_head == rx_len) {
+            int32_t avail = vexGenericSerialReceiveAvail(port);
+            if (avail > (int32_t)sizeof(rx_buffer)) {
+                avail = sizeof(rx_buffer);
+            }
+            int32_t got = avail > 0 ? vexGenericSerialReceive(port, rx_buffer, avail) : 0;
+            if (got <= 0) {
+                // sleep until the serial service sees the next packet coming in. In async mode only the
+                // background task calls update(), so it's the one to suspend
+                rx_listener->wait(SerialIOService::DEFAULT_MAX_LATENCY_MS, handle);
+                continue;
+            }
+            rx_head = 0;
+            rx_len = got;
+        }
+
+        while (rx_head < rx_len) {
+            uint8_t character = rx_buffer[rx_head++];
 
             // if delimiter
             if (character == 0x00) {
@@ -102,7 +119,6 @@ int OdometrySerial::receive_cobs_packet(uint32_t port, uint8_t *buffer, size_t b
                 return -1;
             }
         }
-        vex::this_thread::yield();
     }
 }
 
@@ -3,6 +3,7 @@
 #include "core/utils/command_structure/drive_commands.h"
 #include "core/utils/controls/pidff.h"
 #include "core/utils/controls/state_space/linear_plant_inversion_feedforward.h"
+#include "core/utils/controls/state_space/ltv_gain_table_cache.h"
 #include "core/utils/geometry.h"
 #include "core/utils/math/geometry/rotation2d.h"
 #include "core/utils/math_util.h"
@@ -11,6 +12,11 @@ extern uint64_t init_us;
 
 namespace {
 
+struct TrajectoryReferenceLogMessage
+    : SerialLoggerMessage<TrajectoryReferenceLogMessage, 0x05, uint64_t, float, float, float> {
+    static constexpr const char *field_names() { return "time, x, y, t"; }
+};
+
 void print_trajectory_base_csv(const Trajectory &trajectory) {
     printf("idx,t,s,x,y,heading_deg,curvature,velocity,acceleration,omega\n");
 
@@ -105,7 +111,10 @@ TankDrive::TankDrive(
     turn_default_feedback = config.turn_feedback;
 }
 
-TankDrive::~TankDrive() { reset_auto(); }
+TankDrive::~TankDrive() {
+    reset_auto();
+    delete trajectory_feedforward;
+}
 
 AutoCommand *
 TankDrive::DriveToPointCmd(Feedback &fb, Translation2d pt, vex::directionType dir, double max_speed, double end_speed) {
@@ -176,6 +185,11 @@ AutoCommand *TankDrive::FollowTrajectoryCmd(const Trajectory &trajectory, const
     return new FollowTrajectoryCommand(*this, trajectory, cfg);
 }
 
+AutoCommand *
+TankDrive::FollowTrajectoryCmd(const TrajectoryPrefetch::Handle &prefetch, const TankTrajectoryFollowerConfig &cfg) {
+    return new FollowTrajectoryCommand(*this, prefetch, cfg);
+}
+
 AutoCommand *TankDrive::FollowTrajectoryOpenLoopCmd(const Trajectory &trajectory, bool stop_at_end) {
     return new FollowTrajectoryOpenLoopCommand(*this, trajectory, stop_at_end);
 }
@@ -233,6 +247,21 @@ void TankDrive::reset_auto() {
     trajectory_controller = NULL;
 }
 
+/**
+ * The feedforward for the current path, discretized on dt. It is only rebuilt
+ * when dt or the drive model's gains change, not on every tick, and carries
+ * over between chained paths.
+ */
+LinearPlantInversionFeedforward<2, 2> &TankDrive::trajectory_feedforward_for(Time dt) {
+    if (trajectory_feedforward == NULL || trajectory_feedforward->dt() != dt.s() ||
+        trajectory_feedforward_revision != drive_model->revision()) {
+        delete trajectory_feedforward;
+        trajectory_feedforward = new LinearPlantInversionFeedforward<2, 2>(drive_model->wheel_plant(), dt.s());
+        trajectory_feedforward_revision = drive_model->revision();
+    }
+    return *trajectory_feedforward;
+}
+
 /**
  * Stops rotation of all the motors using their "brake mode"
  */
@@ -298,7 +327,7 @@ Velocity TankDrive::max_linear_velocity() const {
         return 0_inps;
     }
 
-    TankDriveModel::Plant plant = drive_model->chassis_plant();
+    const TankDriveModel::Plant &plant = drive_model->chassis_plant();
     const EVec<2> u{drive_model->max_voltage().V(), drive_model->max_voltage().V()};
     const EVec<2> x_ss = (-plant.A()).lu().solve(plant.B() * u);
     return Velocity::from<inches_per_second_tag>(std::max(0.0, std::abs(x_ss(0))));
@@ -351,7 +380,7 @@ void TankDrive::drive_line(
         delete trajectory_controller;
         trajectory_controller = NULL;
 
-        TankDriveModel::Plant plant = drive_model->wheel_plant();
+        const TankDriveModel::Plant &plant = drive_model->wheel_plant();
         trajectory_controller = new LTVDifferentialDriveController(
           plant,
           drive_model->trackwidth(),
@@ -378,9 +407,7 @@ void TankDrive::drive_line(
     line_prev_velocity_ref = line_velocity_ref;
     const TankDriveModel::StateVector wheel_ref = drive_model->chassis_to_wheels(line_velocity_ref, 0_radps);
 
-    TankDriveModel::Plant plant = drive_model->wheel_plant();
-    LinearPlantInversionFeedforward<2, 2> feedforward(plant, cfg.dt.s());
-    const EVec<2> ff = feedforward.calculate(wheel_ref, wheel_ref, cfg.dt.s());
+    const EVec<2> ff = trajectory_feedforward_for(cfg.dt).calculate(wheel_ref, wheel_ref);
     const EVec<2> ks = drive_model->wheel_stiction_voltages(wheel_ref);
 
     const double observer_left_vel = get_left_velocity();
@@ -1039,7 +1066,10 @@ bool TankDrive::turn_to_heading(double heading_deg, double max_speed, double end
     return true;
 }
 
-bool TankDrive::follow_trajectory(const Trajectory &trajectory, const TankTrajectoryFollowerConfig &cfg) {
+bool TankDrive::follow_trajectory(
+  const Trajectory &trajectory,
+  const TankTrajectoryFollowerConfig &cfg,
+  std::shared_ptr<const LTVDifferentialDriveController::GainTable> gains) {
     constexpr double kTrajectoryOnTargetTime = 0.1;
 
     if (odometry == NULL) {
@@ -1060,40 +1090,33 @@ bool TankDrive::follow_trajectory(const Trajectory &trajectory, const TankTrajec
         delete trajectory_controller;
         trajectory_controller = NULL;
 
-        TankDriveModel::Plant plant = drive_model->wheel_plant();
-        const EVec<5> q_tolerances = cfg.q_tolerances_eigen();
-        const EVec<2> r_tolerances = cfg.r_tolerances_eigen();
-        trajectory_controller = new LTVDifferentialDriveController(
-          plant,
-          drive_model->trackwidth(),
-          q_tolerances,
-          r_tolerances,
-          cfg.dt,
-          cfg.max_velocity,
-          cfg.velocity_step);
+        // Gains are only solved the first time this (model, config) is seen, see LTVGainTableCache
+        if (gains == NULL) {
+            gains = LTVGainTableCache::get(drive_model->wheel_plant(), drive_model->trackwidth(), cfg);
+        }
+        trajectory_controller = new LTVDifferentialDriveController(gains, cfg.q_tolerances_eigen());
         trajectory_settle_checking = false;
         trajectory_settle_start = 0.0;
         trajectory_print_row = 0;
         // print_trajectory_base_csv(trajectory);
         if (logger != NULL) {
-            logger->define_and_send_schema(0x05, "time:u64, x:f32, y:f32, t:f32");
+            logger->send_message_schema<TrajectoryReferenceLogMessage>();
         }
         trajectory_timer.reset();
-        const Trajectory::State t0 = trajectory.sample(Time::from<second_tag>(0.0));
+        trajectory_sampler = trajectory.sampler();
+        const Trajectory::State t0 = trajectory_sampler.sample(Time::from<second_tag>(0.0));
         trajectory_prev_wheel_ref = drive_model->chassis_to_wheels(t0.velocity, t0.velocity * t0.curvature);
         trajectory_log.clear();
         func_initialized = true;
     }
 
     const Time elapsed = Time::from<second_tag>(trajectory_timer.time(sec));
-    const Trajectory::State ref = trajectory.sample(elapsed);
+    const Trajectory::State ref = trajectory_sampler.sample(elapsed);
 
     const AngularVelocity ref_omega = ref.velocity * ref.curvature;
     const TankDriveModel::StateVector wheel_ref = drive_model->chassis_to_wheels(ref.velocity, ref_omega);
 
-    TankDriveModel::Plant plant = drive_model->wheel_plant();
-    LinearPlantInversionFeedforward<2, 2> feedforward(plant, cfg.dt.s());
-    const EVec<2> ff = feedforward.calculate(trajectory_prev_wheel_ref, wheel_ref, cfg.dt.s());
+    const EVec<2> ff = trajectory_feedforward_for(cfg.dt).calculate(trajectory_prev_wheel_ref, wheel_ref);
     const EVec<2> ks = drive_model->wheel_stiction_voltages(wheel_ref);
     trajectory_prev_wheel_ref = wheel_ref;
 
@@ -1115,12 +1138,9 @@ bool TankDrive::follow_trajectory(const Trajectory &trajectory, const TankTrajec
     const double commanded_right = clamp(ff(1) + ks(1) + volts.right.V(), -max_voltage, max_voltage);
 
     if (logger != NULL) {
-        logger->build(0x05)
-          .add(vexSystemHighResTimeGet() - init_us)
-          .add((float)ref.pose.x())
-          .add((float)ref.pose.y())
-          .add((float)ref.pose.rotation().wrapped_degrees_360())
-          .send();
+        logger->log_message<TrajectoryReferenceLogMessage>(
+          vexSystemHighResTimeGet() - init_us, (float)ref.pose.x(), (float)ref.pose.y(),
+          (float)ref.pose.rotation().wrapped_degrees_360());
     }
 
 
@@ -1167,10 +1187,12 @@ bool TankDrive::follow_trajectory_open_loop(const Trajectory &trajectory, bool s
 
     if (!func_initialized) {
         trajectory_timer.reset();
+        trajectory_sampler = trajectory.sampler();
+        trajectory_lookahead_sampler = trajectory.sampler();
         trajectory_print_row = 0;
         print_trajectory_base_csv(trajectory);
         if (logger != NULL) {
-            logger->define_and_send_schema(0x05, "time:u64, x:f32, y:f32, t:f32");
+            logger->send_message_schema<TrajectoryReferenceLogMessage>();
         }
         func_initialized = true;
     }
@@ -1178,8 +1200,8 @@ bool TankDrive::follow_trajectory_open_loop(const Trajectory &trajectory, bool s
     const Time elapsed = Time::from<second_tag>(trajectory_timer.time(sec));
     const Time next_t = min(elapsed + 0.01_s, trajectory.total_time());
     const double dt_step = (next_t - elapsed).s();
-    const Trajectory::State ref = trajectory.sample(elapsed);
-    const Trajectory::State next_ref = trajectory.sample(next_t);
+    const Trajectory::State ref = trajectory_sampler.sample(elapsed);
+    const Trajectory::State next_ref = trajectory_lookahead_sampler.sample(next_t);
 
     const AngularVelocity ref_omega = ref.velocity * ref.curvature;
     const AngularVelocity next_ref_omega = next_ref.velocity * next_ref.curvature;
@@ -1190,21 +1212,19 @@ bool TankDrive::follow_trajectory_open_loop(const Trajectory &trajectory, bool s
     const double observer_right_vel = get_right_velocity();
     const TankDriveModel::StateVector chassis_state = drive_model->wheels_to_chassis(observer_left_vel, observer_right_vel);
 
-    TankDriveModel::Plant plant = drive_model->wheel_plant();
-    LinearPlantInversionFeedforward<2, 2> feedforward(plant, 0.01);
-    const EVec<2> ff = feedforward.calculate(wheel_ref, next_wheel_ref, dt_step);
+    // Every step but the last is exactly 10 ms, only the clipped final step needs discretizing again
+    LinearPlantInversionFeedforward<2, 2> &feedforward = trajectory_feedforward_for(0.01_s);
+    const EVec<2> ff = fabs(dt_step - feedforward.dt()) < 1e-9 ? feedforward.calculate(wheel_ref, next_wheel_ref)
+                                                                : feedforward.calculate(wheel_ref, next_wheel_ref, dt_step);
     const EVec<2> ks = drive_model->wheel_stiction_voltages(next_wheel_ref);
     const double max_voltage = drive_model->max_voltage().V();
     const double commanded_left = clamp(ff(0) + ks(0), -max_voltage, max_voltage);
     const double commanded_right = clamp(ff(1) + ks(1), -max_voltage, max_voltage);
 
     if (logger != NULL) {
-        logger->build(0x05)
-          .add(vexSystemHighResTimeGet() - init_us)
-          .add((float)ref.pose.x())
-          .add((float)ref.pose.y())
-          .add((float)ref.pose.rotation().wrapped_degrees_360())
-          .send();
+        logger->log_message<TrajectoryReferenceLogMessage>(
+          vexSystemHighResTimeGet() - init_us, (float)ref.pose.x(), (float)ref.pose.y(),
+          (float)ref.pose.rotation().wrapped_degrees_360());
     }
 
     print_trajectory_runtime_row(
@@ -90,6 +90,17 @@ void InOrder::on_timeout() {
     }
 }
 
+void InOrder::on_skipped() {
+    if (current_command != nullptr) {
+        current_command->on_skipped();
+    }
+    std::queue<AutoCommand *> remaining = cmds;
+    while (!remaining.empty()) {
+        remaining.front()->on_skipped();
+        remaining.pop();
+    }
+}
+
 struct parallel_runner_info {
     int index;
     std::vector<vex::task *> *runners;
@@ -148,6 +159,14 @@ bool Parallel::run() {
     return all_finished;
 }
 
+void Parallel::on_skipped() {
+    for (int i = 0; i < cmds.size(); i++) {
+        if (cmds[i] != nullptr) {
+            cmds[i]->on_skipped();
+        }
+    }
+}
+
 std::string Parallel::toString() { return int_to_string(runners.size()) + " commands running in parallel"; }
 
 void Parallel::on_timeout() {
@@ -182,6 +201,11 @@ bool Branch::run() {
         choice = cond->test();
         chosen = true;
         tmr.reset();
+        if (choice == false) {
+            true_choice->on_skipped();
+        } else {
+            false_choice->on_skipped();
+        }
     }
 
     double seconds = static_cast<double>(tmr.time()) / 1000.0;
@@ -228,6 +252,10 @@ void Branch::on_timeout() {
     }
     chosen = false;
 }
+void Branch::on_skipped() {
+    false_choice->on_skipped();
+    true_choice->on_skipped();
+}
 
 static int async_runner(void *arg) {
     AutoCommand *cmd = (AutoCommand *)arg;
@@ -346,9 +346,28 @@ FollowTrajectoryCommand::FollowTrajectoryCommand(
   TankDrive &drive_sys, const Trajectory &trajectory, const TankTrajectoryFollowerConfig &cfg)
     : drive_sys(drive_sys), trajectory(&trajectory), cfg(cfg) {}
 
-bool FollowTrajectoryCommand::run() { return drive_sys.follow_trajectory(*trajectory, cfg); }
+FollowTrajectoryCommand::FollowTrajectoryCommand(
+  TankDrive &drive_sys, const TrajectoryPrefetch::Handle &prefetch, const TankTrajectoryFollowerConfig &cfg)
+    : drive_sys(drive_sys), trajectory(NULL), cfg(cfg), prefetch(prefetch) {}
+
+bool FollowTrajectoryCommand::run() {
+    if (prefetch == NULL) {
+        return drive_sys.follow_trajectory(*trajectory, cfg);
+    }
+    if (trajectory == NULL) {
+        // Normally done long before we get here, only blocks if the previous command was shorter than the work
+        trajectory = prefetch->wait();
+        if (trajectory == NULL) {
+            return true;
+        }
+    }
+    return drive_sys.follow_trajectory(*trajectory, cfg, prefetch->gains());
+}
 
 std::string FollowTrajectoryCommand::toString() {
+    if (trajectory == NULL) {
+        return "Following prefetched trajectory";
+    }
     return "Following trajectory for " + double_to_string(trajectory->total_time().s()) + " seconds";
 }
 
@@ -357,6 +376,12 @@ void FollowTrajectoryCommand::on_timeout() {
     drive_sys.reset_auto();
 }
 
+void FollowTrajectoryCommand::on_skipped() {
+    if (prefetch != NULL) {
+        prefetch->cancel();
+    }
+}
+
 FollowTrajectoryOpenLoopCommand::FollowTrajectoryOpenLoopCommand(
   TankDrive &drive_sys, const Trajectory &trajectory, bool stop_at_end)
     : drive_sys(drive_sys), trajectory(&trajectory), stop_at_end(stop_at_end) {}
@@ -0,0 +1,307 @@
+#include "core/utils/controls/state_space/ltv_gain_table_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "vex.h"
+
+constexpr int LTVGainTableCache::KEY_SIZE;
+constexpr uint16_t LTVGainTableCache::FILE_VERSION;
+constexpr size_t LTVGainTableCache::MAX_TABLES;
+
+// File layout (little endian, as stored by the brain)
+/*
+ * +------------- header --------------+
+ * | magic "LTVG" | version:u16 | key_size:u16 | table_count:u32 |
+ * +------------- per table -----------+
+ * | key:f64[key_size] | entry_count:u32 |
+ * | entry_count * (velocity:f64, K:f64[10] column major) |
+ * +-----------------------------------+
+ */
+
+namespace {
+const char kMagic[4] = {'L', 'T', 'V', 'G'};
+constexpr size_t kHeaderSize = 4 + 2 + 2 + 4;
+constexpr size_t kEntrySize = sizeof(double) * (1 + 2 * 5);
+
+struct CacheEntry {
+    LTVGainTableCache::Key key;
+    LTVGainTableCache::TablePtr table;
+    // use_clock at the last get() for this key, 0 if nothing asked for it since it was loaded
+    uint32_t last_use;
+};
+
+std::vector<CacheEntry> entries;
+uint32_t use_clock = 0;
+bool dirty = false;
+vex::mutex cache_mut;
+
+CacheEntry *find_entry(const LTVGainTableCache::Key &key) {
+    for (CacheEntry &entry : entries) {
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// Makes room for one more table by dropping the least recently used one.
+// Controllers holding the dropped table keep their copy.
+void evict_for_insert() {
+    if (entries.size() < LTVGainTableCache::MAX_TABLES) {
+        return;
+    }
+    size_t oldest = 0;
+    for (size_t i = 1; i < entries.size(); ++i) {
+        if (entries[i].last_use < entries[oldest].last_use) {
+            oldest = i;
+        }
+    }
+    entries.erase(entries.begin() + oldest);
+}
+
+template <typename T> void put(std::vector<unsigned char> &data, const T &value) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+    data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T> bool take(const std::vector<unsigned char> &data, size_t &pos, T &value) {
+    if (pos + sizeof(T) > data.size()) {
+        return false;
+    }
+    memcpy(&value, &data[pos], sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+} // namespace
+
+LTVGainTableCache::Key LTVGainTableCache::make_key(
+  const LinearSystem<2, 2, 2> &plant,
+  Length trackwidth,
+  const EVec<5> &q_tolerances,
+  const EVec<2> &r_tolerances,
+  Time dt,
+  Velocity max_velocity,
+  Velocity velocity_step
+) {
+    Key key;
+    const EMat<2, 2> A = plant.A();
+    const EMat<2, 2> B = plant.B();
+    int i = 0;
+    for (int j = 0; j < 4; ++j) {
+        key[i++] = A(j);
+    }
+    for (int j = 0; j < 4; ++j) {
+        key[i++] = B(j);
+    }
+    key[i++] = trackwidth.in();
+    for (int j = 0; j < 5; ++j) {
+        key[i++] = q_tolerances(j);
+    }
+    for (int j = 0; j < 2; ++j) {
+        key[i++] = r_tolerances(j);
+    }
+    key[i++] = dt.s();
+    key[i++] = max_velocity.inps();
+    key[i++] = velocity_step.inps();
+    return key;
+}
+
+LTVGainTableCache::TablePtr LTVGainTableCache::get(
+  const LinearSystem<2, 2, 2> &plant,
+  Length trackwidth,
+  const EVec<5> &q_tolerances,
+  const EVec<2> &r_tolerances,
+  Time dt,
+  Velocity max_velocity,
+  Velocity velocity_step
+) {
+    const Key key = make_key(plant, trackwidth, q_tolerances, r_tolerances, dt, max_velocity, velocity_step);
+
+    cache_mut.lock();
+    CacheEntry *entry = find_entry(key);
+    if (entry != nullptr) {
+        entry->last_use = ++use_clock;
+        TablePtr table = entry->table;
+        cache_mut.unlock();
+        return table;
+    }
+    cache_mut.unlock();
+
+    // Solve outside the lock, this takes a while
+    printf("LTVGainTableCache: computing gain table\n");
+    TablePtr table = std::make_shared<GainTable>(LTVDifferentialDriveController::compute_gain_table(
+      plant, trackwidth, q_tolerances, r_tolerances, dt, max_velocity, velocity_step
+    ));
+
+    cache_mut.lock();
+    entry = find_entry(key);
+    if (entry != nullptr) {
+        // Someone else computed it while we were
+        entry->last_use = ++use_clock;
+        table = entry->table;
+    } else {
+        evict_for_insert();
+        entries.push_back({key, table, ++use_clock});
+        dirty = true;
+    }
+    cache_mut.unlock();
+    return table;
+}
+
+LTVGainTableCache::TablePtr
+LTVGainTableCache::get(const LinearSystem<2, 2, 2> &plant, Length trackwidth, const TankTrajectoryFollowerConfig &cfg) {
+    return get(
+      plant, trackwidth, cfg.q_tolerances_eigen(), cfg.r_tolerances_eigen(), cfg.dt, cfg.max_velocity,
+      cfg.velocity_step
+    );
+}
+
+bool LTVGainTableCache::contains(const Key &key) {
+    cache_mut.lock();
+    const bool found = find_entry(key) != nullptr;
+    cache_mut.unlock();
+    return found;
+}
+
+bool LTVGainTableCache::load_from_sd(const std::string &filename) {
+    vex::brain::sdcard sd;
+    if (!sd.isInserted()) {
+        printf("!! Trying to load LTV gains from No SD Card !!\n");
+        return false;
+    }
+    if (!sd.exists(filename.c_str())) {
+        printf("LTVGainTableCache: %s does not exist yet\n", filename.c_str());
+        return false;
+    }
+
+    const int32_t size = sd.size(filename.c_str());
+    if (size < (int32_t)kHeaderSize) {
+        printf("!! %s is too small to be a gain table file !!\n", filename.c_str());
+        return false;
+    }
+
+    std::vector<unsigned char> data(size);
+    const int32_t readsize = sd.loadfile(filename.c_str(), &data[0], size);
+    if (readsize != size) {
+        printf("!! Error reading from `%s` !!\n", filename.c_str());
+        return false;
+    }
+
+    size_t pos = 0;
+    char magic[4];
+    uint16_t version = 0;
+    uint16_t key_size = 0;
+    uint32_t table_count = 0;
+    take(data, pos, magic);
+    take(data, pos, version);
+    take(data, pos, key_size);
+    take(data, pos, table_count);
+    if (memcmp(magic, kMagic, sizeof(kMagic)) != 0 || version != FILE_VERSION || key_size != KEY_SIZE) {
+        printf("!! `%s` is not a version %d gain table file, ignoring it !!\n", filename.c_str(), FILE_VERSION);
+        return false;
+    }
+
+    // Parse everything before touching the cache so a truncated file loads nothing
+    std::vector<CacheEntry> loaded;
+    for (uint32_t t = 0; t < table_count; ++t) {
+        Key key;
+        uint32_t entry_count = 0;
+        // entry_count comes from the file, compare by division so a bad count can't wrap the check
+        if (!take(data, pos, key) || !take(data, pos, entry_count) || entry_count > (data.size() - pos) / kEntrySize) {
+            printf("!! `%s` is truncated, ignoring it !!\n", filename.c_str());
+            return false;
+        }
+
+        std::shared_ptr<GainTable> table = std::make_shared<GainTable>();
+        for (uint32_t e = 0; e < entry_count; ++e) {
+            double velocity;
+            GainMatrix K;
+            take(data, pos, velocity);
+            memcpy(K.data(), &data[pos], sizeof(double) * K.size());
+            pos += sizeof(double) * K.size();
+            table->insert(velocity, K);
+        }
+        loaded.push_back({key, table, 0});
+    }
+
+    cache_mut.lock();
+    for (const CacheEntry &entry : loaded) {
+        if (entries.size() >= MAX_TABLES) {
+            break;
+        }
+        if (find_entry(entry.key) == nullptr) {
+            entries.push_back(entry);
+        }
+    }
+    cache_mut.unlock();
+
+    printf("LTVGainTableCache: loaded %d tables from %s\n", (int)loaded.size(), filename.c_str());
+    return true;
+}
+
+bool LTVGainTableCache::save_to_sd(const std::string &filename) {
+    cache_mut.lock();
+    // Only tables something asked for since boot are kept, so ones left behind by old gains or configs drop out
+    uint32_t used_count = 0;
+    for (const CacheEntry &entry : entries) {
+        if (entry.last_use != 0) {
+            used_count++;
+        }
+    }
+    if (!dirty && used_count == entries.size()) {
+        cache_mut.unlock();
+        return true;
+    }
+
+    std::vector<unsigned char> data;
+    data.insert(data.end(), kMagic, kMagic + sizeof(kMagic));
+    put(data, FILE_VERSION);
+    put(data, (uint16_t)KEY_SIZE);
+    put(data, used_count);
+    for (const CacheEntry &entry : entries) {
+        if (entry.last_use == 0) {
+            continue;
+        }
+        put(data, entry.key);
+        put(data, (uint32_t)entry.table->size());
+        for (size_t i = 0; i < entry.table->size(); ++i) {
+            const GainMatrix &K = entry.table->values()[i];
+            put(data, entry.table->keys()[i]);
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(K.data());
+            data.insert(data.end(), bytes, bytes + sizeof(double) * K.size());
+        }
+    }
+    cache_mut.unlock();
+
+    vex::brain::sdcard sd;
+    if (!sd.isInserted()) {
+        printf("!! Trying to save LTV gains to No SD Card !!\n");
+        return false;
+    }
+
+    const int32_t written = sd.savefile(filename.c_str(), &data[0], data.size());
+    if (written != (int32_t)data.size()) {
+        printf("!! Error writing to `%s` !!\n", filename.c_str());
+        return false;
+    }
+
+    cache_mut.lock();
+    dirty = false;
+    cache_mut.unlock();
+    return true;
+}
+
+bool LTVGainTableCache::is_dirty() {
+    cache_mut.lock();
+    const bool out = dirty;
+    cache_mut.unlock();
+    return out;
+}
+
+void LTVGainTableCache::clear() {
+    cache_mut.lock();
+    entries.clear();
+    dirty = false;
+    cache_mut.unlock();
+}
@@ -0,0 +1,53 @@
+#include "core/utils/trajectory/trajectory_prefetch.h"
+
+#include <stdio.h>
+
+#include "core/utils/controls/state_space/ltv_gain_table_cache.h"
+
+TrajectoryPrefetch::TrajectoryPrefetch(
+  const Generator &generator, const TankDriveModel &model, const TankTrajectoryFollowerConfig &cfg)
+    : generator_(generator), plant_(model.wheel_plant()), trackwidth_(model.trackwidth()), cfg_(cfg),
+      status_(PENDING), cancel_requested_(false) {}
+
+TrajectoryPrefetch::Handle TrajectoryPrefetch::start(
+  const Generator &generator, const TankDriveModel &model, const TankTrajectoryFollowerConfig &cfg, int32_t priority) {
+    Handle handle(new TrajectoryPrefetch(generator, model, cfg));
+
+    // The task holds its own reference, so dropping every other handle mid-work is fine
+    vex::task(background_task, (void *)new Handle(handle), priority);
+    return handle;
+}
+
+void TrajectoryPrefetch::cancel() {
+    cancel_requested_ = true;
+    int expected = PENDING;
+    status_.compare_exchange_strong(expected, CANCELLED);
+}
+
+const Trajectory *TrajectoryPrefetch::wait() const {
+    while (status() == PENDING) {
+        vexDelay(1);
+    }
+    return ready() ? &trajectory_ : NULL;
+}
+
+int TrajectoryPrefetch::background_task(void *arg) {
+    Handle *handle = (Handle *)arg;
+    TrajectoryPrefetch &self = **handle;
+
+    if (!self.cancel_requested_) {
+        self.trajectory_ = self.generator_();
+    }
+    if (!self.cancel_requested_) {
+        // Solves the table only if robot_init did not already, otherwise this is a lookup
+        self.gains_ = LTVGainTableCache::get(self.plant_, self.trackwidth_, self.cfg_);
+    }
+
+    int expected = PENDING;
+    if (!self.status_.compare_exchange_strong(expected, READY)) {
+        printf("TrajectoryPrefetch: cancelled\n");
+    }
+
+    delete handle;
+    return 0;
+}
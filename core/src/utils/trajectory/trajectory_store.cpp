@@ -0,0 +1,236 @@
+#include "core/utils/trajectory/trajectory_store.h"
+
+#include <map>
+#include <memory>
+#include <stdio.h>
+#include <string.h>
+
+#include "core/utils/trajectory/trajectory_generator.h"
+#include "vex.h"
+
+constexpr uint16_t TrajectoryStore::FILE_VERSION;
+
+// File layout (little endian, as stored by the brain)
+/*
+ * +------------- header --------------+
+ * | magic "TRAJ" | version:u16 | reserved:u16 | fingerprint:u64 | state_count:u32 |
+ * +------------- per state -----------+
+ * | t | velocity | acceleration | x | y | theta | curvature |   (f64, canonical units)
+ * +-----------------------------------+
+ */
+
+namespace {
+const char kMagic[4] = {'T', 'R', 'A', 'J'};
+constexpr size_t kHeaderSize = 4 + 2 + 2 + 8 + 4;
+constexpr size_t kStateFields = 7;
+
+// Trajectories live behind their own allocation and are never reassigned once
+// stored, so references handed out by get() survive later inserts.
+struct StoreEntry {
+    uint64_t fingerprint;
+    std::unique_ptr<Trajectory> trajectory;
+};
+
+std::map<std::string, StoreEntry> entries;
+// Trajectories replaced after their fingerprint changed. Someone may still be
+// following them, so they are kept rather than freed.
+std::vector<std::unique_ptr<Trajectory>> superseded;
+vex::mutex store_mut;
+
+std::string file_name(const std::string &name) { return "traj_" + name + ".bin"; }
+
+// FNV-1a
+void hash_bytes(uint64_t &hash, const void *data, size_t len) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+}
+
+void hash_double(uint64_t &hash, double value) { hash_bytes(hash, &value, sizeof(value)); }
+} // namespace
+
+uint64_t TrajectoryStore::fingerprint(const std::vector<HermitePoint> &waypoints, const TrajectoryConfig &config) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash_double(hash, FILE_VERSION);
+
+    for (const HermitePoint &point : waypoints) {
+        hash_double(hash, point.point.x());
+        hash_double(hash, point.point.y());
+        hash_double(hash, point.tangent.x());
+        hash_double(hash, point.tangent.y());
+        hash_double(hash, point.second_derivative.x());
+        hash_double(hash, point.second_derivative.y());
+    }
+
+    hash_double(hash, config.start_velocity().canonical_value());
+    hash_double(hash, config.end_velocity().canonical_value());
+    hash_double(hash, config.max_velocity().canonical_value());
+    hash_double(hash, config.max_acceleration().canonical_value());
+    hash_double(hash, config.is_reversed() ? 1.0 : 0.0);
+
+    const Pose2d probe_pose(0.0, 0.0, 0.0);
+    const double probe_curvatures[] = {0.0, 0.5, -2.0, 10.0};
+    const double probe_velocities[] = {0.0, 0.5, -0.5, 1.5};
+    for (const auto &constraint : config.constraints()) {
+        for (double k : probe_curvatures) {
+            for (double v : probe_velocities) {
+                const Curvature curvature = Curvature::from_canonical(k);
+                const Velocity velocity = Velocity::from_canonical(v);
+                const TrajectoryConstraint::MinMax min_max =
+                  constraint->min_max_acceleration(probe_pose, curvature, velocity);
+                hash_double(hash, constraint->max_velocity(probe_pose, curvature, velocity).canonical_value());
+                hash_double(hash, min_max.minAcceleration.canonical_value());
+                hash_double(hash, min_max.maxAcceleration.canonical_value());
+            }
+        }
+    }
+
+    return hash;
+}
+
+const Trajectory &
+TrajectoryStore::get(const std::string &name, const std::vector<HermitePoint> &waypoints, const TrajectoryConfig &config) {
+    const uint64_t key = fingerprint(waypoints, config);
+
+    store_mut.lock();
+    std::map<std::string, StoreEntry>::iterator found = entries.find(name);
+    if (found != entries.end() && found->second.fingerprint == key) {
+        const Trajectory &trajectory = *found->second.trajectory;
+        store_mut.unlock();
+        return trajectory;
+    }
+    store_mut.unlock();
+
+    Trajectory trajectory;
+    if (!load_from_sd(name, key, trajectory)) {
+        printf("TrajectoryStore: generating %s\n", name.c_str());
+        trajectory = TrajectoryGenerator::generate_trajectory(waypoints, config);
+        save_to_sd(name, key, trajectory);
+    }
+
+    store_mut.lock();
+    StoreEntry &entry = entries[name];
+    if (!entry.trajectory || entry.fingerprint != key) {
+        // Another task may have missed on the same name while we were
+        // generating; whichever stores first wins and the other copy is dropped
+        if (entry.trajectory) {
+            superseded.push_back(std::move(entry.trajectory));
+        }
+        entry.fingerprint = key;
+        entry.trajectory.reset(new Trajectory(std::move(trajectory)));
+    }
+    const Trajectory &out = *entry.trajectory;
+    store_mut.unlock();
+    return out;
+}
+
+bool TrajectoryStore::save_to_sd(const std::string &name, uint64_t fingerprint, const Trajectory &trajectory) {
+    vex::brain::sdcard sd;
+    if (!sd.isInserted()) {
+        printf("!! Trying to save trajectory to No SD Card !!\n");
+        return false;
+    }
+
+    const std::vector<Trajectory::State> &states = trajectory.states();
+    std::vector<unsigned char> data(kHeaderSize + states.size() * kStateFields * sizeof(double));
+    unsigned char *pos = &data[0];
+
+    const uint16_t reserved = 0;
+    const uint32_t state_count = states.size();
+    memcpy(pos, kMagic, sizeof(kMagic));
+    pos += sizeof(kMagic);
+    memcpy(pos, &FILE_VERSION, sizeof(FILE_VERSION));
+    pos += sizeof(FILE_VERSION);
+    memcpy(pos, &reserved, sizeof(reserved));
+    pos += sizeof(reserved);
+    memcpy(pos, &fingerprint, sizeof(fingerprint));
+    pos += sizeof(fingerprint);
+    memcpy(pos, &state_count, sizeof(state_count));
+    pos += sizeof(state_count);
+
+    for (const Trajectory::State &state : states) {
+        const double fields[kStateFields] = {
+          state.t.canonical_value(),
+          state.velocity.canonical_value(),
+          state.acceleration.canonical_value(),
+          state.pose.x(),
+          state.pose.y(),
+          state.pose.rotation().radians(),
+          state.curvature.canonical_value(),
+        };
+        memcpy(pos, fields, sizeof(fields));
+        pos += sizeof(fields);
+    }
+
+    const std::string filename = file_name(name);
+    const int32_t written = sd.savefile(filename.c_str(), &data[0], data.size());
+    if (written != (int32_t)data.size()) {
+        printf("!! Error writing to `%s` !!\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TrajectoryStore::load_from_sd(const std::string &name, uint64_t fingerprint, Trajectory &out) {
+    vex::brain::sdcard sd;
+    if (!sd.isInserted()) {
+        return false;
+    }
+
+    const std::string filename = file_name(name);
+    if (!sd.exists(filename.c_str())) {
+        return false;
+    }
+
+    const int32_t size = sd.size(filename.c_str());
+    if (size < (int32_t)kHeaderSize) {
+        return false;
+    }
+
+    std::vector<unsigned char> data(size);
+    if (sd.loadfile(filename.c_str(), &data[0], size) != size) {
+        printf("!! Error reading from `%s` !!\n", filename.c_str());
+        return false;
+    }
+
+    const unsigned char *pos = &data[0];
+    uint16_t version;
+    uint64_t stored_fingerprint;
+    uint32_t state_count;
+    if (memcmp(pos, kMagic, sizeof(kMagic)) != 0) {
+        return false;
+    }
+    pos += sizeof(kMagic);
+    memcpy(&version, pos, sizeof(version));
+    pos += sizeof(version) + sizeof(uint16_t);
+    memcpy(&stored_fingerprint, pos, sizeof(stored_fingerprint));
+    pos += sizeof(stored_fingerprint);
+    memcpy(&state_count, pos, sizeof(state_count));
+    pos += sizeof(state_count);
+
+    if (version != FILE_VERSION || stored_fingerprint != fingerprint) {
+        printf("TrajectoryStore: %s is stale\n", filename.c_str());
+        return false;
+    }
+    if (kHeaderSize + state_count * kStateFields * sizeof(double) != (size_t)size) {
+        printf("!! `%s` is truncated, ignoring it !!\n", filename.c_str());
+        return false;
+    }
+
+    std::vector<Trajectory::State> states;
+    states.reserve(state_count);
+    for (uint32_t i = 0; i < state_count; ++i) {
+        double fields[kStateFields];
+        memcpy(fields, pos, sizeof(fields));
+        pos += sizeof(fields);
+        states.emplace_back(
+          Time::from_canonical(fields[0]), Velocity::from_canonical(fields[1]), Acceleration::from_canonical(fields[2]), Pose2d(fields[3], fields[4], fields[5]),
+          Curvature::from_canonical(fields[6])
+        );
+    }
+
+    out = Trajectory(std::move(states));
+    return true;
+}
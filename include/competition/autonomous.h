@@ -9,4 +9,10 @@ void right_auto_path();
 void left_auto_path();
 void right_awp_path();
 void left_awp_path();
-void skills_path();
\ No newline at end of file
+void skills_path();
+
+/**
+ * Generates (or loads from the SD card) every trajectory the autonomous
+ * routines use, so none are generated during the auton period
+*/
+void precompute_trajectories();
@@ -59,6 +59,7 @@
 #include "core/utils/geometry.h"
 #include "core/utils/graph_drawer.h"
 #include "core/utils/interpolating_map.h"
+#include "core/utils/uniform_interpolating_map.h"
 #include "core/utils/logger.h"
 #include "core/utils/math_util.h"
 #include "core/utils/moving_average.h"
@@ -6,45 +6,80 @@
 // CRC-16-CCITT
 // polynomial 0x1021 (x^16 + x^12 + x^5 + 1)
 // initial value 0xFFFF
+//
+// Table driven, four bytes per step (slicing-by-4) with a byte-at-a-time tail.
+// Output is identical to the classic bit-at-a-time loop.
 
 class CRC16 {
+public:
+    // Seed for update() when running a CRC by hand
+    static constexpr uint16_t INITIAL_VALUE = 0xFFFF;
+
 private:
     static constexpr uint16_t POLYNOMIAL = 0x1021;
-    static constexpr uint16_t INITIAL_VALUE = 0xFFFF;
-    
+
+    // Defined in crc16.cpp
+    static const uint16_t TABLE[4][256];
+
+    uint16_t state = INITIAL_VALUE;
+
 public:
-    static uint16_t calculate(const uint8_t* data, size_t length) {
-        uint16_t crc = INITIAL_VALUE;
-        
-        for (size_t i = 0; i < length; i++) {
-            crc ^= (uint16_t)data[i] << 8;
-            
-            for (int j = 0; j < 8; j++) {
-                if (crc & 0x8000) {
-                    crc = (crc << 1) ^ POLYNOMIAL;
-                } else {
-                    crc = crc << 1;
-                }
-            }
+    /**
+     * Feeds bytes into a running CRC. Start from INITIAL_VALUE (or use the
+     * instance API below) to compute a CRC while a packet is being built.
+     */
+    static uint16_t update(uint16_t crc, const uint8_t* data, size_t length) {
+        while (length >= 4) {
+            crc ^= ((uint16_t)data[0] << 8) | data[1];
+            crc = TABLE[3][crc >> 8] ^ TABLE[2][crc & 0xFF] ^ TABLE[1][data[2]] ^ TABLE[0][data[3]];
+            data += 4;
+            length -= 4;
+        }
+
+        while (length > 0) {
+            crc = (crc << 8) ^ TABLE[0][(crc >> 8) ^ *data];
+            data++;
+            length--;
         }
-        
+
         return crc;
     }
-    
+
+    static uint16_t update(uint16_t crc, uint8_t byte) {
+        return (crc << 8) ^ TABLE[0][(crc >> 8) ^ byte];
+    }
+
+    static uint16_t calculate(const uint8_t* data, size_t length) {
+        return update(INITIAL_VALUE, data, length);
+    }
+
     static bool verify(const uint8_t* data, size_t length) {
         if (length < 2) return false;
-        
+
         uint16_t calculated = calculate(data, length - 2);
-        
+
         uint16_t stored = ((uint16_t)data[length - 2] << 8) | data[length - 1];
-        
+
         return calculated == stored;
     }
-    
+
     static void append(uint8_t* buffer, size_t length) {
         uint16_t crc = calculate(buffer, length);
         buffer[length] = (crc >> 8) & 0xFF;
         buffer[length + 1] = crc & 0xFF;
     }
-};
 
+    // Incremental use:
+    //   CRC16 crc;
+    //   crc.add(header, 1);
+    //   crc.add(payload, n);
+    //   uint16_t value = crc.value();
+
+    void reset() { state = INITIAL_VALUE; }
+
+    void add(uint8_t byte) { state = update(state, byte); }
+
+    void add(const uint8_t* data, size_t length) { state = update(state, data, length); }
+
+    uint16_t value() const { return state; }
+};
@@ -1,21 +1,140 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
 #include "logger/packet.h"
+#include "logger/typed_message.h"
+#include "core/device/serial_io_service.h"
 
 #include "v5.h"
+#include "vex.h"
 
 #define HANDSHAKE_ID 0xFF
 #define HANDSHAKE_RETRY_MS 100
 
+// Async mode queue: SERIAL_LOGGER_QUEUE_SLOTS packets of up to
+// SERIAL_LOGGER_SLOT_BYTES encoded bytes each. Slots must be a power of two.
+#define SERIAL_LOGGER_QUEUE_SLOTS 32
+#define SERIAL_LOGGER_SLOT_BYTES 256
+// Longest the idle drain task stays suspended without a packet being queued
+#define SERIAL_LOGGER_DRAIN_IDLE_MS 1000
+
 class SerialLogger {
 private:
+    // One encoded packet. sequence follows the bounded MPMC queue scheme: a
+    // slot at position p is free when sequence == p and full when sequence == p + 1.
+    struct QueueSlot {
+        std::atomic<uint32_t> sequence;
+        uint16_t length;
+        uint8_t message_id;
+        uint8_t data[SERIAL_LOGGER_SLOT_BYTES];
+    };
+
+    static_assert((SERIAL_LOGGER_QUEUE_SLOTS & (SERIAL_LOGGER_QUEUE_SLOTS - 1)) == 0,
+                  "SERIAL_LOGGER_QUEUE_SLOTS must be a power of two");
+
     uint32_t port;
+    // wakes on handshake replies, and the drain task on newly queued packets
+    SerialIOService::Listener* listener;
     SerialLoggerEncoder encoder;
     bool connected;
     uint32_t last_handshake_attempt_ms;
     uint8_t rx_buffer[16];
     size_t rx_buffer_len;
+
+    bool async;
+    vex::task drain_task;
+    QueueSlot queue[SERIAL_LOGGER_QUEUE_SLOTS];
+    std::atomic<uint32_t> enqueue_pos;
+    std::atomic<uint32_t> dequeue_pos;
+    std::atomic<uint32_t> high_water_mark;
+    std::atomic<uint32_t> dropped[SERIAL_LOGGER_MAX_SCHEMAS];
+
+    // Hands a finished packet to the port. In async mode this is a copy into
+    // the queue and never touches the UART, so it is safe from control loops.
+    bool transmit(uint8_t message_id, const uint8_t* packet, size_t length) {
+        if (length == 0) return false;
+
+        if (!async) {
+            vexGenericSerialTransmit(port, (uint8_t*)packet, length);
+            return true;
+        }
+
+        message_id &= 0x7F;
+        if (length > SERIAL_LOGGER_SLOT_BYTES) {
+            dropped[message_id].fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        QueueSlot* slot;
+        uint32_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            slot = &queue[pos & (SERIAL_LOGGER_QUEUE_SLOTS - 1)];
+            int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Full, the drain task is behind. Drop instead of waiting.
+                dropped[message_id].fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        memcpy(slot->data, packet, length);
+        slot->length = (uint16_t)length;
+        slot->message_id = message_id;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+
+        listener->notify();
+
+        uint32_t depth = pos + 1 - dequeue_pos.load(std::memory_order_relaxed);
+        uint32_t peak = high_water_mark.load(std::memory_order_relaxed);
+        while (depth > peak && !high_water_mark.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {
+        }
+        return true;
+    }
+
+    // Writes queued packets while the UART has room for them. Returns the
+    // number of packets written.
+    int drain() {
+        int written = 0;
+        while (true) {
+            uint32_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            QueueSlot* slot = &queue[pos & (SERIAL_LOGGER_QUEUE_SLOTS - 1)];
+            if (slot->sequence.load(std::memory_order_acquire) != pos + 1) {
+                return written;
+            }
+            if (vexGenericSerialWriteFree(port) < (int32_t)slot->length) {
+                return written;
+            }
+
+            vexGenericSerialTransmit(port, slot->data, slot->length);
+            slot->sequence.store(pos + SERIAL_LOGGER_QUEUE_SLOTS, std::memory_order_release);
+            dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+            written++;
+        }
+    }
+
+    static int drain_thread(void* self) {
+        SerialLogger* logger = (SerialLogger*)self;
+        while (true) {
+            logger->drain();
+            if (logger->queue_depth() > 0) {
+                // waiting on the UART to free up room
+                vexDelay(1);
+            } else {
+                // log() notifies the listener, the timeout is only a backstop
+                logger->listener->wait(SERIAL_LOGGER_DRAIN_IDLE_MS, &logger->drain_task);
+            }
+        }
+        return 0;
+    }
     
     void send_handshake() {
         while (vexGenericSerialReceiveAvail(port) > 0) {
@@ -36,7 +155,7 @@ private:
     }
     
     void process_incoming_handshake() {
-      vexDelay(25);
+        listener->wait(25);
         while (vexGenericSerialReceiveAvail(port) > 0) {
             int32_t c = vexGenericSerialReadChar(port);
             if (c < 0) break;
@@ -66,10 +185,82 @@ private:
     
 public:
     SerialLogger(uint32_t port_index) 
-        : port(port_index), connected(false), last_handshake_attempt_ms(0), rx_buffer_len(0) {
+        : port(port_index), listener(SerialIOService::instance().listen(port_index, 10)), connected(false),
+          last_handshake_attempt_ms(0), rx_buffer_len(0), async(false),
+          enqueue_pos(0), dequeue_pos(0), high_water_mark(0) {
+        for (uint32_t i = 0; i < SERIAL_LOGGER_QUEUE_SLOTS; i++) {
+            queue[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < SERIAL_LOGGER_MAX_SCHEMAS; i++) {
+            dropped[i].store(0, std::memory_order_relaxed);
+        }
         vexGenericSerialEnable(port, 0);
         vexGenericSerialBaudrate(port, 921600);
     }
+
+    /**
+     * Switches to async mode. From now on every log call only encodes into a
+     * lock free queue and a low priority task feeds the UART as its write
+     * buffer frees up. When the queue is full, packets are dropped and counted
+     * per message ID instead of blocking the caller.
+     */
+    void start_async(int32_t priority = vex::thread::threadPrioritylow) {
+        if (async) return;
+        async = true;
+        drain_task = vex::task(drain_thread, (void*)this, priority);
+    }
+
+    bool is_async() const {
+        return async;
+    }
+
+    /**
+     * Packets dropped for this message ID because the queue was full
+     */
+    uint32_t dropped_count(uint8_t message_id) const {
+        return dropped[message_id & 0x7F].load(std::memory_order_relaxed);
+    }
+
+    uint32_t total_dropped() const {
+        uint32_t total = 0;
+        for (size_t i = 0; i < SERIAL_LOGGER_MAX_SCHEMAS; i++) {
+            total += dropped[i].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    /**
+     * Packets currently waiting for the UART
+     */
+    uint32_t queue_depth() const {
+        return enqueue_pos.load(std::memory_order_relaxed) - dequeue_pos.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Most packets ever waiting at once. Close to SERIAL_LOGGER_QUEUE_SLOTS
+     * means the link is saturated.
+     */
+    uint32_t queue_high_water_mark() const {
+        return high_water_mark.load(std::memory_order_relaxed);
+    }
+
+    void reset_stats() {
+        high_water_mark.store(queue_depth(), std::memory_order_relaxed);
+        for (size_t i = 0; i < SERIAL_LOGGER_MAX_SCHEMAS; i++) {
+            dropped[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void print_stats() const {
+        printf("logger queue: depth %lu, high water %lu/%d\n", (unsigned long)queue_depth(),
+               (unsigned long)queue_high_water_mark(), SERIAL_LOGGER_QUEUE_SLOTS);
+        for (size_t i = 0; i < SERIAL_LOGGER_MAX_SCHEMAS; i++) {
+            uint32_t count = dropped[i].load(std::memory_order_relaxed);
+            if (count > 0) {
+                printf("  0x%02X dropped %lu\n", (unsigned)i, (unsigned long)count);
+            }
+        }
+    }
     
     void update() {
         if (connected) return;
@@ -86,8 +277,9 @@ public:
             last_handshake_attempt_ms = now;
         }
         
-          vexDelay(100);
-          process_incoming_handshake();
+        // returns as soon as the reply starts coming in
+        listener->wait(100);
+        process_incoming_handshake();
     }
     
     bool is_connected() const {
@@ -104,31 +296,54 @@ public:
         
         uint8_t packet[256];
         size_t length = encoder.encode_schema_packet(message_id, schema_str, packet);
-        
-        if (length > 0) {
-            vexGenericSerialTransmit(port, packet, length);
-        }
+        transmit(message_id, packet, length);
     }
     
+    /**
+     * Sends the compile time schema of a SerialLoggerMessage type
+     */
+    template<typename MESSAGE>
+    void send_message_schema() {
+        send_schema(MESSAGE::ID, MESSAGE::schema());
+    }
+
+    /**
+     * Logs one SerialLoggerMessage. The packet is built on the stack at
+     * offsets known at compile time, no schema lookup happens at runtime.
+     *
+     *   logger.log_message<PoseMessage>(time, x, y, t);
+     *
+     * The values must already have the message's field types; an implicit
+     * conversion (double to float, int to uint64_t, ...) fails to compile.
+     */
+    template<typename MESSAGE, typename... ARGS>
+    void log_message(ARGS... values) {
+        static_assert(MESSAGE::template accepts<ARGS...>(),
+                      "log_message values must match the message's field types exactly");
+        if (!connected) return;
+
+        uint8_t packet[MESSAGE::MAX_PACKET_SIZE];
+        size_t length = MESSAGE::encode(packet, values...);
+        transmit(MESSAGE::ID, packet, length);
+    }
+
     void log(uint8_t message_id, const double* values, size_t num_values) {
         if (!connected) return;
         
         uint8_t packet[256];
         size_t length = encoder.encode_data_packet(message_id, values, num_values, packet);
-        
-        if (length > 0) {
-            vexGenericSerialTransmit(port, packet, length);
-        }
+        transmit(message_id, packet, length);
     }
     
     class LogBuilder {
     private:
         SerialLogger* logger;
         SerialLoggerEncoder::SerialLoggerDataBuilder builder;
+        uint8_t message_id;
         
     public:
-        LogBuilder(SerialLogger* log, SerialLoggerEncoder::SerialLoggerDataBuilder bldr) 
-            : logger(log), builder(bldr) {}
+        LogBuilder(SerialLogger* log, SerialLoggerEncoder::SerialLoggerDataBuilder bldr, uint8_t id) 
+            : logger(log), builder(bldr), message_id(id) {}
         
         LogBuilder& add(uint8_t value) { builder.add(value); return *this; }
         LogBuilder& add(uint16_t value) { builder.add(value); return *this; }
@@ -146,14 +361,69 @@ public:
             
             uint8_t packet[256];
             size_t length = builder.send(packet);
-            if (length > 0) {
-                vexGenericSerialTransmit(logger->port, packet, length);
-            }
+            logger->transmit(message_id, packet, length);
         }
     };
     
+    /**
+     * Collects several data records (usually everything logged in one tick)
+     * into one frame so they share a single crc, COBS frame and transmit.
+     * The frame is sent early if the next record would not fit.
+     *
+     *   SerialLogger::Batch batch = logger.batch();
+     *   batch.add<PoseMessage>(time, x, y, t);
+     *   batch.add(0x02, values, 3);
+     *   batch.send();
+     */
+    class Batch {
+    private:
+        SerialLogger* logger;
+        SerialLoggerBatch frame;
+
+    public:
+        explicit Batch(SerialLogger* log) : logger(log) {}
+
+        template<typename MESSAGE, typename... ARGS>
+        Batch& add(ARGS... values) {
+            static_assert(MESSAGE::template accepts<ARGS...>(),
+                          "Batch::add values must match the message's field types exactly");
+            if (!logger->connected) return *this;
+
+            uint8_t* payload = frame.reserve(MESSAGE::ID, MESSAGE::PAYLOAD_SIZE);
+            if (!payload) {
+                send();
+                payload = frame.reserve(MESSAGE::ID, MESSAGE::PAYLOAD_SIZE);
+            }
+            MESSAGE::encode_payload(payload, values...);
+            return *this;
+        }
+
+        Batch& add(uint8_t message_id, const double* values, size_t num_values) {
+            if (!logger->connected) return *this;
+
+            if (!logger->encoder.encode_data_record(message_id, values, num_values, frame) && !frame.empty()) {
+                send();
+                logger->encoder.encode_data_record(message_id, values, num_values, frame);
+            }
+            return *this;
+        }
+
+        void send() {
+            if (logger->connected && !frame.empty()) {
+                uint8_t packet[SERIAL_LOGGER_BATCH_MTU + 3];
+                size_t length = frame.finish(packet);
+                logger->transmit(frame.record_count() == 1 ? frame.first_message_id() : SERIAL_LOGGER_BATCH_ID, packet, length);
+            }
+            frame.reset();
+        }
+    };
+
+    Batch batch() {
+        return Batch(this);
+    }
+
     LogBuilder build(uint8_t message_id) {
-        return LogBuilder(this, encoder.build(message_id));
+        return LogBuilder(this, encoder.build(message_id), message_id);
     }
     
     void define_and_send_schema(uint8_t message_id, const char* schema_str) {
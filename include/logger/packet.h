@@ -4,10 +4,10 @@
 #include <string.h>
 #include <string>
 #include <vector>
-#include <map>
 #include "crc16.h"
 #include "cobs.h"
 #include "fixedpoint.h"
+#include "varint.h"
 
 // doesn't include crc and id
 #define MAX_DATA_BYTES 192
@@ -28,6 +28,7 @@ struct SerialLoggerField {
     std::string name;
     SerialLoggerTypeCode type;
     std::string group;
+    bool delta = false;     // "d" prefixed type, e.g. "time:du64"
     
     size_t get_size() const;
     const char* get_type_name() const;
@@ -47,34 +48,232 @@ struct SerialLoggerSchema {
     }
 };
 
+// Writes one field value into its slot of a data packet
+typedef void (*SerialLoggerFieldEncoder)(uint8_t* buffer, double value);
+
+// A field of a registered schema, with everything needed to encode it resolved up front
+struct SerialLoggerFieldSlot {
+    SerialLoggerFieldEncoder encode;
+    uint8_t offset;     // from the start of the payload (after the id byte)
+    uint8_t size;
+    SerialLoggerTypeCode type;
+    bool delta;
+    bool is_signed;     // delta is zig-zag encoded (signed integer and Q formats)
+    uint64_t previous;  // last value sent, for delta fields
+};
+
+// Compressed data packets
+//
+// Any integer or Q format type can be prefixed with "d" in the schema
+// ("time:du64, x:dQ16_16"). A schema with such a field is sent as
+//   [id][header] fields... [crc16]
+// where header is bit 7: keyframe, bits 0-6: sequence number (mod 128).
+// Plain fields keep their fixed width encoding. A delta field is the
+// difference from the previous packet, modulo its width, as a varint:
+// unsigned types as is (monotonic timestamps stay short), signed and Q types
+// zig-zagged. A keyframe sends deltas from zero, i.e. absolute values. After a
+// sequence gap the host drops packets until the next keyframe.
+#define SERIAL_LOGGER_DEFAULT_KEYFRAME_INTERVAL 32
+
+struct SerialLoggerCompiledSchema {
+    bool registered = false;
+    SerialLoggerSchema schema;
+    std::vector<SerialLoggerFieldSlot> slots;
+    size_t total_size = 0;      // fixed width layout
+
+    bool compressed = false;
+    size_t max_size = 0;        // worst case compressed payload
+    uint16_t keyframe_interval = SERIAL_LOGGER_DEFAULT_KEYFRAME_INTERVAL;
+    uint16_t since_keyframe = 0;
+    uint8_t sequence = 0;
+    bool force_keyframe = true;
+};
+
+#define SERIAL_LOGGER_MAX_SCHEMAS 128
+
+// Batched frame, several data records under one CRC and one COBS frame:
+//   [SERIAL_LOGGER_BATCH_ID] ([id][length][payload])... [crc16]
+// The batch id is reserved and cannot be used for a schema.
+#define SERIAL_LOGGER_BATCH_ID 0x7E
+// Largest raw batch frame (id, records and crc) before COBS. Encoded with the
+// delimiter it still fits the logger's 256 byte packet buffers.
+#define SERIAL_LOGGER_BATCH_MTU 250
+
+// One data record inside a batch frame
+struct SerialLoggerRecord {
+    uint8_t message_id;
+    const uint8_t* payload;
+    uint8_t size;
+};
+
+class SerialLoggerBatch {
+private:
+    uint8_t raw_buffer[SERIAL_LOGGER_BATCH_MTU];
+    size_t length;
+    size_t count;
+
+public:
+    SerialLoggerBatch() { reset(); }
+
+    void reset() {
+        raw_buffer[0] = SERIAL_LOGGER_BATCH_ID;
+        length = 1;
+        count = 0;
+    }
+
+    /**
+     * Makes room for one record.
+     *
+     * @return where to write the payload, or null if the frame is full
+     */
+    uint8_t* reserve(uint8_t message_id, size_t payload_size) {
+        if (payload_size > MAX_DATA_BYTES || length + 2 + payload_size + 2 > SERIAL_LOGGER_BATCH_MTU) {
+            return nullptr;
+        }
+        raw_buffer[length] = message_id & 0x7F;
+        raw_buffer[length + 1] = (uint8_t)payload_size;
+        uint8_t* payload = raw_buffer + length + 2;
+        length += 2 + payload_size;
+        count++;
+        return payload;
+    }
+
+    size_t record_count() const { return count; }
+
+    uint8_t first_message_id() const { return raw_buffer[1]; }
+
+    // Shrinks the record reserve() just returned, once its real size is known
+    void trim_last(size_t reserved_size, size_t payload_size) {
+        length -= reserved_size - payload_size;
+        raw_buffer[length - payload_size - 1] = (uint8_t)payload_size;
+    }
+
+    bool empty() const { return count == 0; }
+
+    /**
+     * Writes the COBS framed batch with its trailing 0x00. A batch holding a
+     * single record is written as a plain data packet since that is shorter.
+     *
+     * @param output at least SERIAL_LOGGER_BATCH_MTU + 3 bytes
+     * @return the number of bytes written, 0 if the batch is empty
+     */
+    size_t finish(uint8_t* output) {
+        if (count == 0) return 0;
+
+        size_t cobs_len;
+        if (count == 1) {
+            uint8_t packet[MAX_DATA_BYTES + 3];
+            size_t payload_size = raw_buffer[2];
+            packet[0] = raw_buffer[1];
+            memcpy(packet + 1, raw_buffer + 3, payload_size);
+            CRC16::append(packet, 1 + payload_size);
+            cobs_len = COBS::encode(packet, 1 + payload_size + 2, output);
+        } else {
+            CRC16::append(raw_buffer, length);
+            cobs_len = COBS::encode(raw_buffer, length + 2, output);
+        }
+        output[cobs_len] = 0x00;
+        return cobs_len + 1;
+    }
+
+    /**
+     * Host side: splits a COBS decoded batch frame (starting with
+     * SERIAL_LOGGER_BATCH_ID and ending with its crc) into its records. The
+     * records point into frame, decode each one like a data packet with the
+     * same id.
+     *
+     * @return the number of records, 0 if the frame is corrupt
+     */
+    static size_t split(const uint8_t* frame, size_t frame_length, SerialLoggerRecord* records, size_t max_records) {
+        if (frame_length < 3 || frame[0] != SERIAL_LOGGER_BATCH_ID || !CRC16::verify(frame, frame_length)) {
+            return 0;
+        }
+
+        const size_t end = frame_length - 2;
+        size_t pos = 1;
+        size_t n = 0;
+        while (pos < end) {
+            if (n == max_records || pos + 2 > end || pos + 2 + frame[pos + 1] > end) {
+                return 0;
+            }
+            records[n].message_id = frame[pos];
+            records[n].size = frame[pos + 1];
+            records[n].payload = frame + pos + 2;
+            pos += 2 + records[n].size;
+            n++;
+        }
+        return n;
+    }
+};
+
 class SerialLoggerEncoder {
 private:
-    std::map<uint8_t, SerialLoggerSchema> schemas;
+    // Indexed directly by message id (0x00 - 0x7F)
+    SerialLoggerCompiledSchema schemas[SERIAL_LOGGER_MAX_SCHEMAS];
     
     SerialLoggerTypeCode parse_type(const char* type_str) const;
-    size_t serialize_value(uint8_t* buffer, const SerialLoggerField& field, double value) const;
+    static SerialLoggerFieldEncoder encoder_for(SerialLoggerTypeCode type);
+
+    SerialLoggerCompiledSchema* compiled_schema(uint8_t message_id) {
+        SerialLoggerCompiledSchema& compiled = schemas[message_id & 0x7F];
+        return compiled.registered ? &compiled : nullptr;
+    }
+
+    // Turns a fixed width payload into the compressed form, updating the
+    // schema's delta state. Returns the compressed payload size.
+    static size_t compress(SerialLoggerCompiledSchema& compiled, const uint8_t* fixed, uint8_t* output);
+
+    // Encodes values at their fixed width offsets, then compresses if the
+    // schema has delta fields. Returns the payload size.
+    static size_t encode_payload(SerialLoggerCompiledSchema& compiled, const double* values, uint8_t* output);
     
 public:
     bool register_schema(uint8_t message_id, const char* schema_str);
     
     const SerialLoggerSchema* get_schema(uint8_t message_id) const;
+
+    const SerialLoggerCompiledSchema* get_compiled_schema(uint8_t message_id) const {
+        const SerialLoggerCompiledSchema& compiled = schemas[message_id & 0x7F];
+        return compiled.registered ? &compiled : nullptr;
+    }
     
     bool has_schema(uint8_t message_id) const {
-        return schemas.find(message_id) != schemas.end();
+        return schemas[message_id & 0x7F].registered;
+    }
+
+    /**
+     * How often a compressed schema sends absolute values so the host can
+     * resync after a lost packet. 1 makes every packet a keyframe.
+     */
+    void set_keyframe_interval(uint8_t message_id, uint16_t interval) {
+        schemas[message_id & 0x7F].keyframe_interval = interval > 0 ? interval : 1;
+    }
+
+    // Makes the next packet of this schema a keyframe, e.g. after the schema is resent
+    void force_keyframe(uint8_t message_id) {
+        schemas[message_id & 0x7F].force_keyframe = true;
     }
     
     size_t encode_schema_packet(uint8_t message_id, const char* schema_str, uint8_t* output);
     
     size_t encode_data_packet(uint8_t message_id, const double* values, size_t num_values, uint8_t* output);
+
+    // Encodes one data record into a batch. Returns false if there is no
+    // schema, the value count is wrong or the batch is full.
+    bool encode_data_record(uint8_t message_id, const double* values, size_t num_values, SerialLoggerBatch& batch);
     
     
     class SerialLoggerDataBuilder {
     private:
-        SerialLoggerEncoder* encoder;
         uint8_t raw_buffer[MAX_DATA_BYTES + 3];
-        size_t offset;
         size_t field_index;
-        const SerialLoggerSchema* schema;
+        SerialLoggerCompiledSchema* compiled;
+
+        // Next slot to fill, or null if the schema is missing or already full
+        const SerialLoggerFieldSlot* next_slot() const {
+            if (!compiled || field_index >= compiled->slots.size()) return nullptr;
+            return &compiled->slots[field_index];
+        }
         
     public:
         SerialLoggerDataBuilder(SerialLoggerEncoder* enc, uint8_t message_id);
@@ -92,15 +291,16 @@ public:
 
         template<int INT_BITS, int FRAC_BITS>
         SerialLoggerDataBuilder& add(const QNumber<INT_BITS, FRAC_BITS>& value) {
-            if (!schema || field_index >= schema->fields.size()) return *this;
-            value.to_bytes(raw_buffer + offset);
-            offset += value.byte_size();
+            const SerialLoggerFieldSlot* slot = next_slot();
+            if (!slot) return *this;
+            // Fixed point values are exact in a double, so this re-encodes losslessly into the field's format
+            slot->encode(raw_buffer + 1 + slot->offset, (double)value);
             field_index++;
             return *this;
         }
         size_t send(uint8_t* output);
         
-        bool is_valid() const { return schema != nullptr; }
+        bool is_valid() const { return compiled != nullptr; }
     };
     
     SerialLoggerDataBuilder build(uint8_t message_id) {
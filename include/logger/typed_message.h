@@ -0,0 +1,252 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+#include "crc16.h"
+#include "cobs.h"
+#include "fixedpoint.h"
+#include "packet.h"
+
+// Compile time typed logger messages.
+//
+// A message is declared once with its field types and names:
+//
+//   struct PoseMessage : SerialLoggerMessage<PoseMessage, 0x01, uint64_t, float, float, float> {
+//       static constexpr const char* field_names() { return "time, x, y, t"; }
+//   };
+//
+// PoseMessage::schema() is "time:u64, x:f32, y:f32, t:f32", built by the
+// compiler, and PoseMessage::encode(out, time, x, y, t) writes a complete
+// COBS framed data packet with fixed offsets and no runtime schema. Passing
+// the wrong number of values, or a type with no wire format, fails to compile.
+// SerialLogger::log_message and Batch::add go further and require every value
+// to already be its field's exact type, so a double handed to a float or
+// QNumber field, or an int handed to a u64, is an error instead of a silent
+// conversion. Cast at the call site.
+//
+// The packets are byte for byte what SerialLoggerEncoder produces for the same
+// schema string, so the host decodes them the same way.
+
+// Wire format of a field type. Only the types below can be logged.
+template<typename T>
+struct SerialLoggerFieldTraits;
+
+#define SERIAL_LOGGER_PLAIN_FIELD(TYPE, NAME)                                   \
+    template<>                                                                  \
+    struct SerialLoggerFieldTraits<TYPE> {                                      \
+        static constexpr const char* type_name() { return NAME; }               \
+        static constexpr size_t size() { return sizeof(TYPE); }                 \
+        static void write(uint8_t* buffer, TYPE value) {                        \
+            memcpy(buffer, &value, sizeof(TYPE));                               \
+        }                                                                       \
+    };
+
+#define SERIAL_LOGGER_FIXED_FIELD(INT_BITS, FRAC_BITS, NAME)                    \
+    template<>                                                                  \
+    struct SerialLoggerFieldTraits<QNumber<INT_BITS, FRAC_BITS>> {              \
+        static constexpr const char* type_name() { return NAME; }               \
+        static constexpr size_t size() {                                        \
+            return QNumber<INT_BITS, FRAC_BITS>::byte_size();                   \
+        }                                                                       \
+        static void write(uint8_t* buffer, QNumber<INT_BITS, FRAC_BITS> value) { \
+            value.toBytes(buffer);                                              \
+        }                                                                       \
+    };
+
+// The brain is little endian, same as the wire format
+SERIAL_LOGGER_PLAIN_FIELD(uint8_t, "u8")
+SERIAL_LOGGER_PLAIN_FIELD(uint16_t, "u16")
+SERIAL_LOGGER_PLAIN_FIELD(uint32_t, "u32")
+SERIAL_LOGGER_PLAIN_FIELD(uint64_t, "u64")
+SERIAL_LOGGER_PLAIN_FIELD(int8_t, "i8")
+SERIAL_LOGGER_PLAIN_FIELD(int16_t, "i16")
+SERIAL_LOGGER_PLAIN_FIELD(int32_t, "i32")
+SERIAL_LOGGER_PLAIN_FIELD(int64_t, "i64")
+SERIAL_LOGGER_PLAIN_FIELD(float, "f32")
+SERIAL_LOGGER_PLAIN_FIELD(double, "f64")
+
+SERIAL_LOGGER_FIXED_FIELD(3, 4, "Q3_4")
+SERIAL_LOGGER_FIXED_FIELD(4, 4, "Q4_4")
+SERIAL_LOGGER_FIXED_FIELD(7, 1, "Q7_1")
+SERIAL_LOGGER_FIXED_FIELD(1, 7, "Q1_7")
+SERIAL_LOGGER_FIXED_FIELD(6, 2, "Q6_2")
+SERIAL_LOGGER_FIXED_FIELD(2, 6, "Q2_6")
+SERIAL_LOGGER_FIXED_FIELD(7, 8, "Q7_8")
+SERIAL_LOGGER_FIXED_FIELD(8, 8, "Q8_8")
+SERIAL_LOGGER_FIXED_FIELD(15, 1, "Q15_1")
+SERIAL_LOGGER_FIXED_FIELD(1, 15, "Q1_15")
+SERIAL_LOGGER_FIXED_FIELD(9, 6, "Q9_6")
+SERIAL_LOGGER_FIXED_FIELD(10, 6, "Q10_6")
+SERIAL_LOGGER_FIXED_FIELD(12, 12, "Q12_12")
+SERIAL_LOGGER_FIXED_FIELD(16, 8, "Q16_8")
+SERIAL_LOGGER_FIXED_FIELD(8, 16, "Q8_16")
+SERIAL_LOGGER_FIXED_FIELD(15, 16, "Q15_16")
+SERIAL_LOGGER_FIXED_FIELD(16, 16, "Q16_16")
+SERIAL_LOGGER_FIXED_FIELD(24, 8, "Q24_8")
+SERIAL_LOGGER_FIXED_FIELD(8, 24, "Q8_24")
+SERIAL_LOGGER_FIXED_FIELD(31, 32, "Q31_32")
+SERIAL_LOGGER_FIXED_FIELD(32, 32, "Q32_32")
+
+#undef SERIAL_LOGGER_PLAIN_FIELD
+#undef SERIAL_LOGGER_FIXED_FIELD
+
+namespace serial_logger_detail {
+
+constexpr size_t str_len(const char* s) {
+    return *s == '\0' ? 0 : 1 + str_len(s + 1);
+}
+
+constexpr size_t count_names(const char* s) {
+    return *s == '\0' ? 1 : (*s == ',' ? 1 : 0) + count_names(s + 1);
+}
+
+template<typename... FIELDS>
+struct FieldList;
+
+template<>
+struct FieldList<> {
+    static constexpr size_t payload_size() { return 0; }
+    static constexpr size_t type_names_length() { return 0; }
+    static constexpr const char* type_name(size_t) { return ""; }
+};
+
+template<typename T, typename... REST>
+struct FieldList<T, REST...> {
+    static constexpr size_t payload_size() {
+        return SerialLoggerFieldTraits<T>::size() + FieldList<REST...>::payload_size();
+    }
+    static constexpr size_t type_names_length() {
+        return str_len(SerialLoggerFieldTraits<T>::type_name()) + FieldList<REST...>::type_names_length();
+    }
+    static constexpr const char* type_name(size_t index) {
+        return index == 0 ? SerialLoggerFieldTraits<T>::type_name() : FieldList<REST...>::type_name(index - 1);
+    }
+};
+
+// Character k of the schema string: every comma separated name in `names`
+// followed by ':' and the type name of the matching field.
+template<typename LIST>
+constexpr char schema_char(const char* names, size_t field, size_t k) {
+    return (*names != ',' && *names != '\0')
+        ? (k == 0 ? *names : schema_char<LIST>(names + 1, field, k - 1))
+        : k == 0 ? ':'
+        : k - 1 < str_len(LIST::type_name(field)) ? LIST::type_name(field)[k - 1]
+        : *names == '\0' ? '\0'
+        : k - 1 == str_len(LIST::type_name(field)) ? ','
+        : schema_char<LIST>(names + 1, field + 1, k - 2 - str_len(LIST::type_name(field)));
+}
+
+template<typename... TYPES>
+struct TypeList {};
+
+template<size_t... IS>
+struct IndexSequence {};
+
+template<size_t N, size_t... IS>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, IS...> {};
+
+template<size_t... IS>
+struct MakeIndexSequence<0, IS...> {
+    typedef IndexSequence<IS...> type;
+};
+
+template<typename MESSAGE, typename SEQUENCE>
+struct SchemaString;
+
+template<typename MESSAGE, size_t... IS>
+struct SchemaString<MESSAGE, IndexSequence<IS...>> {
+    static constexpr char value[sizeof...(IS) + 1] = {MESSAGE::schema_char(IS)..., '\0'};
+};
+
+template<typename MESSAGE, size_t... IS>
+constexpr char SchemaString<MESSAGE, IndexSequence<IS...>>::value[sizeof...(IS) + 1];
+
+} // namespace serial_logger_detail
+
+template<typename MESSAGE, uint8_t MESSAGE_ID, typename... FIELDS>
+class SerialLoggerMessage {
+private:
+    typedef serial_logger_detail::FieldList<FIELDS...> Fields;
+
+public:
+    static constexpr uint8_t ID = MESSAGE_ID & 0x7F;
+    static constexpr size_t NUM_FIELDS = sizeof...(FIELDS);
+    static constexpr size_t PAYLOAD_SIZE = Fields::payload_size();
+    // id + payload + crc, COBS encoded, plus the 0x00 delimiter
+    static constexpr size_t RAW_SIZE = 1 + PAYLOAD_SIZE + 2;
+    static constexpr size_t MAX_PACKET_SIZE = RAW_SIZE + RAW_SIZE / 254 + 1 + 1;
+
+    static_assert(PAYLOAD_SIZE <= MAX_DATA_BYTES, "Logger message payload is larger than MAX_DATA_BYTES");
+    static_assert(ID != SERIAL_LOGGER_BATCH_ID, "Message ID is reserved for batches");
+
+    static constexpr size_t schema_length() {
+        return serial_logger_detail::str_len(MESSAGE::field_names()) + NUM_FIELDS + Fields::type_names_length();
+    }
+
+    static constexpr char schema_char(size_t k) {
+        return serial_logger_detail::schema_char<Fields>(MESSAGE::field_names(), 0, k);
+    }
+
+    /**
+     * The schema string to send to the host, e.g. "time:u64, x:f32"
+     */
+    static const char* schema() {
+        static_assert(serial_logger_detail::count_names(MESSAGE::field_names()) == NUM_FIELDS,
+                      "field_names() must name every field, separated by commas");
+        typedef typename serial_logger_detail::MakeIndexSequence<schema_length()>::type Sequence;
+        return serial_logger_detail::SchemaString<MESSAGE, Sequence>::value;
+    }
+
+    /**
+     * True when ARGS (ignoring const and references) are exactly FIELDS, in
+     * order. Used to reject implicit conversions at the logging call site.
+     */
+    template<typename... ARGS>
+    static constexpr bool accepts() {
+        return std::is_same<serial_logger_detail::TypeList<typename std::decay<ARGS>::type...>,
+                            serial_logger_detail::TypeList<FIELDS...>>::value;
+    }
+
+    /**
+     * Writes just the payload (no id, crc or framing), e.g. into a batch.
+     *
+     * @param output at least PAYLOAD_SIZE bytes
+     */
+    static void encode_payload(uint8_t* output, FIELDS... values) {
+        size_t offset = 0;
+        int expand[] = {0, (SerialLoggerFieldTraits<FIELDS>::write(output + offset, values),
+                            offset += SerialLoggerFieldTraits<FIELDS>::size(), 0)...};
+        (void)expand;
+    }
+
+    /**
+     * Writes a complete data packet (COBS framed, with the trailing 0x00).
+     *
+     * @param output at least MAX_PACKET_SIZE bytes
+     * @return the number of bytes written
+     */
+    static size_t encode(uint8_t* output, FIELDS... values) {
+        uint8_t raw_buffer[RAW_SIZE];
+        raw_buffer[0] = ID;
+        encode_payload(raw_buffer + 1, values...);
+
+        CRC16::append(raw_buffer, 1 + PAYLOAD_SIZE);
+
+        size_t cobs_len = COBS::encode(raw_buffer, RAW_SIZE, output);
+        output[cobs_len] = 0x00;
+        return cobs_len + 1;
+    }
+};
+
+template<typename MESSAGE, uint8_t MESSAGE_ID, typename... FIELDS>
+constexpr uint8_t SerialLoggerMessage<MESSAGE, MESSAGE_ID, FIELDS...>::ID;
+template<typename MESSAGE, uint8_t MESSAGE_ID, typename... FIELDS>
+constexpr size_t SerialLoggerMessage<MESSAGE, MESSAGE_ID, FIELDS...>::NUM_FIELDS;
+template<typename MESSAGE, uint8_t MESSAGE_ID, typename... FIELDS>
+constexpr size_t SerialLoggerMessage<MESSAGE, MESSAGE_ID, FIELDS...>::PAYLOAD_SIZE;
+template<typename MESSAGE, uint8_t MESSAGE_ID, typename... FIELDS>
+constexpr size_t SerialLoggerMessage<MESSAGE, MESSAGE_ID, FIELDS...>::RAW_SIZE;
+template<typename MESSAGE, uint8_t MESSAGE_ID, typename... FIELDS>
+constexpr size_t SerialLoggerMessage<MESSAGE, MESSAGE_ID, FIELDS...>::MAX_PACKET_SIZE;
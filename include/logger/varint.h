@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// LEB128 style varints: 7 bits per byte, least significant group first, high
+// bit set on every byte but the last. Signed values are zig-zag mapped first
+// so small negative numbers stay short (0, -1, 1, -2 ... -> 0, 1, 2, 3 ...).
+
+class Varint {
+public:
+    // A 64 bit value takes at most 10 bytes
+    static constexpr size_t MAX_BYTES = 10;
+
+    // Worst case size of a value that is `bytes` wide
+    static constexpr size_t max_size(size_t bytes) {
+        return (bytes * 8 + 6) / 7;
+    }
+
+    static uint64_t zigzag(int64_t value) {
+        return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    }
+
+    static int64_t unzigzag(uint64_t value) {
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    static size_t encode(uint64_t value, uint8_t* output) {
+        size_t length = 0;
+        while (value >= 0x80) {
+            output[length++] = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        output[length++] = (uint8_t)value;
+        return length;
+    }
+
+    /**
+     * @return bytes consumed, 0 if the input ends mid value or is too long
+     */
+    static size_t decode(const uint8_t* input, size_t input_length, uint64_t* value) {
+        uint64_t result = 0;
+        for (size_t i = 0; i < input_length && i < MAX_BYTES; i++) {
+            result |= (uint64_t)(input[i] & 0x7F) << (7 * i);
+            if ((input[i] & 0x80) == 0) {
+                *value = result;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+};
@@ -11,7 +11,11 @@
  * x = [pleft; vleft; pright; vright; log(kvl); log(kal); log(kva); log(kaa)]
  * u = [Vleft; Vright]
  *
- *
+ * All four gains are per wheel, in V/(in/s) and V/(in/s^2). TankDriveModel's
+ * angular gains are per rad/s of chassis rotation, so kva and kaa have to be
+ * multiplied by trackwidth / 2 (inches per radian) before going into
+ * TankDriveModel::set_gains, and only while no path or observer is using the
+ * model.
  */
 class DriveParamUKF {
   public:
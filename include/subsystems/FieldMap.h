@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Everything on the field the lidar can hit (perimeter walls and field
+ * elements) as line segments, in field inches.
+ */
+class FieldMap {
+public:
+    struct Segment {
+        double x0, y0, x1, y1;
+    };
+
+    void add_segment(double x0, double y0, double x1, double y1);
+
+    /**
+     * Adds the outline of a width x height rectangle centered on (cx, cy),
+     * rotated by angle radians.
+     */
+    void add_box(double cx, double cy, double width, double height, double angle = 0);
+
+    /**
+     * @return distance from (x, y) along heading (radians) to the first
+     * segment hit, or max_range if nothing is hit
+     */
+    double ray_cast(double x, double y, double heading, double max_range = 1e9) const;
+
+    /**
+     * FNV-1a of every segment, used to tell whether a stored range table was
+     * built from this map.
+     */
+    uint64_t fingerprint() const;
+
+    const std::vector<Segment>& segments() const { return segments_; }
+
+private:
+    std::vector<Segment> segments_;
+};
+
+/**
+ * FieldMap::ray_cast sampled on a position x heading grid, so the lidar
+ * measurement model is a trilinear blend of 8 table entries instead of a ray
+ * cast against every segment for every sigma point.
+ *
+ * Ranges are stored as Q10.6 inches (the lidar's own resolution). At the
+ * default 2in / 2 degree spacing the table is 73 x 73 x 180 entries, about
+ * 1.9MB. Building it is about a million ray casts: 0.15s on a desktop, and
+ * expected to take seconds on the brain's Cortex-A9 (build() prints how long
+ * it actually took). So it is written to the SD card and reused until the
+ * map changes:
+ *
+ *   robot_init():   field_ranges.load_or_build(map);
+ */
+class FieldRangeTable {
+public:
+    /// Bump whenever the file layout changes
+    static constexpr uint16_t FILE_VERSION = 1;
+    static constexpr const char* DEFAULT_FILENAME = "field_ranges.bin";
+    /// Largest range a Q10.6 entry holds
+    static constexpr double MAX_RANGE = 1023.0;
+    /// Samples further apart than EDGE_SPREAD + EDGE_SPREAD_PER_INCH * range
+    /// straddle an edge, those lookups are ray cast exactly instead
+    static constexpr double EDGE_SPREAD = 2.0;
+    static constexpr double EDGE_SPREAD_PER_INCH = 0.1;
+
+    /**
+     * @param field_size the table covers [0, field_size] in x and y
+     * @param cell_size grid spacing in inches
+     * @param angle_bins heading samples per revolution
+     */
+    FieldRangeTable(double field_size, double cell_size = 2.0, int angle_bins = 180);
+
+    /**
+     * Ray casts every grid point and heading, and prints how long that took.
+     */
+    void build(const FieldMap& map);
+
+    /**
+     * Reads the table from the SD card if it was built from this map with the
+     * same grid.
+     *
+     * @return true if the table was loaded
+     */
+    bool load_from_sd(const FieldMap& map, const std::string& filename = DEFAULT_FILENAME);
+
+    /**
+     * @return true if the whole file was written
+     */
+    bool save_to_sd(const std::string& filename = DEFAULT_FILENAME) const;
+
+    /**
+     * Loads the table for this map, or builds it and saves it if the stored
+     * one is missing or stale.
+     */
+    void load_or_build(const FieldMap& map, const std::string& filename = DEFAULT_FILENAME);
+
+    bool ready() const { return !ranges_.empty(); }
+
+    /**
+     * @return true if (x, y) is inside the sampled area
+     */
+    bool contains(double x, double y) const;
+
+    /**
+     * Interpolated range from (x, y) along heading (radians). (x, y) must be
+     * inside the table, see contains(). Near the edge of an element the
+     * samples disagree, so those few lookups ray cast the map instead.
+     */
+    double range(double x, double y, double heading) const;
+
+private:
+    size_t index(int ix, int iy, int bin) const {
+        return ((size_t)iy * nodes_ + ix) * angle_bins_ + bin;
+    }
+
+    double cell_size_;
+    int nodes_;
+    int angle_bins_;
+    uint64_t fingerprint_ = 0;
+    std::vector<uint16_t> ranges_;
+    FieldMap map_; // for lookups across an edge
+};
@@ -6,35 +6,16 @@
 #include "core/utils/math/geometry/rotation2d.h"
 #include "core/utils/controls/state_space/tank_drive_observer.h"
 #include "core/utils/math/estimator/unscented_kalman_filter.h"
-#include "core/utils/math/numerical/numerical_integration.h"
 #include "logger/logger.h"
+#include "subsystems/LidarUKF.h"
 #include <cstdint>
 #include <cmath>
 #include <limits>
 #include <vex_motorgroup.h>
 #include <vex_task.h>
 
-// 140.5in interior
-constexpr double FIELD_OFFSET = 1;
-constexpr double FIELD_SIZE = 142.5;
-constexpr double WALL_MIN = FIELD_OFFSET;
-constexpr double WALL_MAX = FIELD_SIZE - (FIELD_OFFSET * 2);
-
-constexpr double LIDAR_OFFSET_X = -4.5;
-constexpr double LIDAR_OFFSET_Y = 6.2;
-constexpr double LIDAR_OFFSET_ANGLE = M_PI;
-
-// ughies
-namespace lidar_ukf {
-    EVec<3> dynamics(const EVec<3>& x, const EVec<3>& u);
-    EVec<2> measurement(const EVec<3>& xhat, const EVec<3>& u);
-    EVec<3> mean_state(const EMat<3, 5>& sigmas, const EVec<5>& Wm);
-    EVec<2> mean_meas(const EMat<2, 5>& sigmas, const EVec<5>& Wm);
-    EVec<3> residual_state(const EVec<3>& a, const EVec<3>& b);
-    EVec<2> residual_meas(const EVec<2>& a, const EVec<2>& b);
-    EVec<3> add_state(const EVec<3>& a, const EVec<3>& b);
-    UnscentedKalmanFilter<3, 3, 2> createUKF();
-}
+// Beams per second the sensor sends while spinning, sets how often the serial service checks the port
+constexpr uint32_t LIDAR_BEAM_HZ = 5000;
 
 class LidarReceiver : public COBSSerialDevice {
 public:
@@ -62,6 +43,20 @@ public:
 
     bool is_running() const { return running_; }
 
+    /**
+     * Collects accepted beams and applies them in one stacked UKF correct
+     * (with one predict) instead of a predict and correct per beam. Off by
+     * default: the whole batch is scored against the pose at flush time, so
+     * it trades accuracy for CPU. Every batch costs a LIDAR_MAX_BATCH row
+     * correct, so it only saves time from about 8 beams up. tools/lidar_replay
+     * measures both.
+     *
+     * @param enabled false to go back to one correct per beam
+     * @param batch_size beams per correct, at most LIDAR_MAX_BATCH
+     * @param max_latency_ms a partial batch is applied once its first beam is this old
+     */
+    void set_batching(bool enabled, int batch_size = LIDAR_MAX_BATCH, double max_latency_ms = 20);
+
     double BEAM_TOLERANCE = 10;
 private:
     vex::inertial *imu;
@@ -82,9 +77,19 @@ private:
     // x [x, y, theta], u [vx, vy, omega], y [distance, lidar_angle]
     UnscentedKalmanFilter<3, 3, 2> ukf_;
 
+    bool batching_ = false;
+    int batch_size_ = LIDAR_MAX_BATCH;
+    uint64_t batch_latency_us_ = 20000;
+    int batch_count_ = 0;
+    uint64_t batch_start_us_ = 0;
+    lidar_ukf::BatchVector batch_ranges_ = lidar_ukf::BatchVector::Zero();
+    lidar_ukf::BatchVector batch_angles_ = lidar_ukf::BatchVector::Zero();
+
     Pose2d pose_out_; // updates every 10ms for odom compatability
 
     EVec<3> get_robot_velocity(); // from encoders
+    void predict_to(uint64_t now_us);
+    void correct_batch();
 
     friend int lidar_thread(void* ptr);
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "core/utils/math/eigen_interface.h"
+#include "core/utils/math/estimator/unscented_kalman_filter.h"
+#include "core/utils/math/numerical/numerical_integration.h"
+#include "subsystems/FieldMap.h"
+#include <cmath>
+
+// The lidar UKF's field geometry and models. Nothing in here touches vex, so
+// tools/lidar_replay can run it on a desktop.
+
+// 140.5in interior
+constexpr double FIELD_OFFSET = 1;
+constexpr double FIELD_SIZE = 142.5;
+constexpr double WALL_MIN = FIELD_OFFSET;
+constexpr double WALL_MAX = FIELD_SIZE - (FIELD_OFFSET * 2);
+
+constexpr double LIDAR_OFFSET_X = -4.5;
+constexpr double LIDAR_OFFSET_Y = 6.2;
+constexpr double LIDAR_OFFSET_ANGLE = M_PI;
+
+// Most beams folded into one UKF correct when batching
+constexpr int LIDAR_MAX_BATCH = 16;
+
+// The long goals sit above the floor on end supports. Until their height is checked against the lidar's
+// mounting height, keep them out of the field map so beams passing under them aren't predicted short
+constexpr bool LIDAR_MAP_LONG_GOALS = false;
+
+// ughies
+namespace lidar_ukf {
+    EVec<3> dynamics(const EVec<3>& x, const EVec<3>& u);
+    constexpr double RANGE_STDDEV = 20;
+    typedef EVec<LIDAR_MAX_BATCH> BatchVector;
+
+    // Walls plus the field elements that block beams
+    FieldMap field_map();
+    // Measure ranges from this table instead of the bare walls, nullptr to go back
+    void use_field_ranges(const FieldRangeTable* table);
+
+    double expected_range(const EVec<3>& xhat, double angle_deg);
+    EVec<2> measurement(const EVec<3>& xhat, const EVec<3>& u);
+    BatchVector measurement_batch(const EVec<3>& xhat, const BatchVector& angles, int count);
+    EVec<3> mean_state(const EMat<3, 5>& sigmas, const EVec<5>& Wm);
+    EVec<2> mean_meas(const EMat<2, 5>& sigmas, const EVec<5>& Wm);
+    EVec<3> residual_state(const EVec<3>& a, const EVec<3>& b);
+    EVec<2> residual_meas(const EVec<2>& a, const EVec<2>& b);
+    EVec<3> add_state(const EVec<3>& a, const EVec<3>& b);
+    UnscentedKalmanFilter<3, 3, 2> createUKF();
+
+    // One stacked correct for the first count beams, the caller predicts first
+    void correct_batch(UnscentedKalmanFilter<3, 3, 2>& ukf, const BatchVector& ranges, const BatchVector& angles, int count);
+}
@@ -9,6 +9,8 @@
 #include <vex_global.h>
 
 #include "core/utils/trajectory/trajectory.h"
+#include "core/utils/trajectory/trajectory_prefetch.h"
+#include "core/utils/trajectory/trajectory_store.h"
 
 #define LOG 3
 
@@ -77,7 +79,7 @@ AutoCommand *OdomLogCmd() {
 
 // --- Trajectories ---
 
-Trajectory spawn_to_right_loader() {  
+const Trajectory &spawn_to_right_loader() {  
   std::vector<HermitePoint> points = {
     {19.500, 55.000, 0.000, -30.000},
     {14.000, 25.000, -90.000, -2.000},
@@ -90,12 +92,10 @@ Trajectory spawn_to_right_loader() {
   config.set_track_width(11.8_in);
   config.add_constraint(CentripetalAccelerationConstraint(100.000_inps2));
   config.add_constraint(TankVoltageConstraint(0.175_VpInPs, 0.042_VpInPs2, 12.000_V, 12.000_in));
-  Trajectory trajectory = TrajectoryGenerator::generate_trajectory(points, config);
-
-  return trajectory;
+  return TrajectoryStore::get("spawn_to_right_loader", points, config);
 }
 
-Trajectory spawn_to_left_loader() {
+const Trajectory &spawn_to_left_loader() {
   using namespace units::literals;
 
   std::vector<HermitePoint> points = {
@@ -110,10 +110,10 @@ Trajectory spawn_to_left_loader() {
   config.set_track_width(11.8_in);
   config.add_constraint(CentripetalAccelerationConstraint(100.000_inps2));
   config.add_constraint(TankVoltageConstraint(0.175_VpInPs, 0.042_VpInPs2, 12.000_V, 12.000_in));
-  return TrajectoryGenerator::generate_trajectory(points, config);
+  return TrajectoryStore::get("spawn_to_left_loader", points, config);
 }
 
-Trajectory right_loader_to_goal() {  
+const Trajectory &right_loader_to_goal() {  
   std::vector<HermitePoint> points = {
     {12.000, 25.000, 30.000, 0.000},
     {32.000, 23.750, 20.000, 0.000},
@@ -127,12 +127,10 @@ Trajectory right_loader_to_goal() {
   config.set_track_width(11.8_in);
   config.add_constraint(CentripetalAccelerationConstraint(180.000_inps2));
   config.add_constraint(TankVoltageConstraint(0.175_VpInPs, 0.042_VpInPs2, 12.000_V, 12.000_in));
-  Trajectory trajectory = TrajectoryGenerator::generate_trajectory(points, config);
-
-  return trajectory;
+  return TrajectoryStore::get("right_loader_to_goal", points, config);
 }
 
-Trajectory left_loader_to_top_center_1() {
+const Trajectory &left_loader_to_top_center_1() {
   using namespace units::literals;
 
   std::vector<HermitePoint> points = {
@@ -147,10 +145,10 @@ Trajectory left_loader_to_top_center_1() {
   config.set_track_width(11.8_in);
   config.add_constraint(CentripetalAccelerationConstraint(180.000_inps2));
   config.add_constraint(TankVoltageConstraint(0.119_VpInps, 0.017_VpInps2, 12.000_V, 12.000_in));
-  return TrajectoryGenerator::generate_trajectory(points, config);
+  return TrajectoryStore::get("left_loader_to_top_center_1", points, config);
 }
 
-Trajectory left_loader_to_top_center_2() {
+const Trajectory &left_loader_to_top_center_2() {
   using namespace units::literals;
 
   std::vector<HermitePoint> points = {
@@ -165,10 +163,10 @@ Trajectory left_loader_to_top_center_2() {
   config.set_track_width(11.800_in);
   config.add_constraint(CentripetalAccelerationConstraint(180.000_inps2));
   config.add_constraint(TankVoltageConstraint(0.119_VpInps, 0.017_VpInps2, 12.000_V, 11.800_in));
-  return TrajectoryGenerator::generate_trajectory(points, config);
+  return TrajectoryStore::get("left_loader_to_top_center_2", points, config);
 }
 
-Trajectory top_center_to_bottom_center_1() {
+const Trajectory &top_center_to_bottom_center_1() {
   using namespace units::literals;
 
   std::vector<HermitePoint> points = {
@@ -183,7 +181,16 @@ Trajectory top_center_to_bottom_center_1() {
   config.set_reversed(true);
   config.add_constraint(CentripetalAccelerationConstraint(180.000_inps2));
   config.add_constraint(TankVoltageConstraint(0.119_VpInps, 0.017_VpInps2, 12.000_V, 11.800_in));
-  return TrajectoryGenerator::generate_trajectory(points, config);
+  return TrajectoryStore::get("top_center_to_bottom_center_1", points, config);
+}
+
+void precompute_trajectories() {
+  spawn_to_right_loader();
+  spawn_to_left_loader();
+  right_loader_to_goal();
+  left_loader_to_top_center_1();
+  left_loader_to_top_center_2();
+  top_center_to_bottom_center_1();
 }
 
 // --- Paths ---
@@ -319,8 +326,10 @@ void left_awp_path() {
 
   int wait_score_middle = 0; // ms
 
-  Trajectory left_loader_to_top_center = left_loader_to_top_center_1() + left_loader_to_top_center_2();
-  Trajectory top_center_to_bottom_center = top_center_to_bottom_center_1();
+  // Joining the two segments copies every state, let it happen while the robot drives to the loader
+  TrajectoryPrefetch::Handle left_loader_to_top_center = TrajectoryPrefetch::start(
+    [] { return left_loader_to_top_center_1() + left_loader_to_top_center_2(); }, drive_model, trajectory_follower_config);
+  const Trajectory &top_center_to_bottom_center = top_center_to_bottom_center_1();
 
   CommandController cc{
     EOABackupCmd(),
@@ -90,6 +90,69 @@ const char* SerialLoggerField::get_type_name() const {
 }
 
 
+// =============================================================================
+// Field encoders, picked once per field when a schema is registered
+// =============================================================================
+
+// The brain is little endian, same as the wire format, so fixed width fields are plain copies
+template<typename T>
+static void encode_integer(uint8_t* buffer, double value) {
+    T v = (T)value;
+    memcpy(buffer, &v, sizeof(T));
+}
+
+static void encode_f32(uint8_t* buffer, double value) {
+    float v = (float)value;
+    memcpy(buffer, &v, sizeof(float));
+}
+
+static void encode_f64(uint8_t* buffer, double value) {
+    memcpy(buffer, &value, sizeof(double));
+}
+
+template<int INT_BITS, int FRAC_BITS>
+static void encode_fixed(uint8_t* buffer, double value) {
+    QNumber<INT_BITS, FRAC_BITS> q(value);
+    q.toBytes(buffer);
+}
+
+SerialLoggerFieldEncoder SerialLoggerEncoder::encoder_for(SerialLoggerTypeCode type) {
+    switch (type) {
+        case SerialLoggerTypeCode::U8: return &encode_integer<uint8_t>;
+        case SerialLoggerTypeCode::U16: return &encode_integer<uint16_t>;
+        case SerialLoggerTypeCode::U32: return &encode_integer<uint32_t>;
+        case SerialLoggerTypeCode::U64: return &encode_integer<uint64_t>;
+        case SerialLoggerTypeCode::I8: return &encode_integer<int8_t>;
+        case SerialLoggerTypeCode::I16: return &encode_integer<int16_t>;
+        case SerialLoggerTypeCode::I32: return &encode_integer<int32_t>;
+        case SerialLoggerTypeCode::I64: return &encode_integer<int64_t>;
+        case SerialLoggerTypeCode::F32: return &encode_f32;
+        case SerialLoggerTypeCode::F64: return &encode_f64;
+        case SerialLoggerTypeCode::Q3_4: return &encode_fixed<3, 4>;
+        case SerialLoggerTypeCode::Q4_4: return &encode_fixed<4, 4>;
+        case SerialLoggerTypeCode::Q7_1: return &encode_fixed<7, 1>;
+        case SerialLoggerTypeCode::Q1_7: return &encode_fixed<1, 7>;
+        case SerialLoggerTypeCode::Q6_2: return &encode_fixed<6, 2>;
+        case SerialLoggerTypeCode::Q2_6: return &encode_fixed<2, 6>;
+        case SerialLoggerTypeCode::Q7_8: return &encode_fixed<7, 8>;
+        case SerialLoggerTypeCode::Q8_8: return &encode_fixed<8, 8>;
+        case SerialLoggerTypeCode::Q15_1: return &encode_fixed<15, 1>;
+        case SerialLoggerTypeCode::Q1_15: return &encode_fixed<1, 15>;
+        case SerialLoggerTypeCode::Q9_6: return &encode_fixed<9, 6>;
+        case SerialLoggerTypeCode::Q10_6: return &encode_fixed<10, 6>;
+        case SerialLoggerTypeCode::Q12_12: return &encode_fixed<12, 12>;
+        case SerialLoggerTypeCode::Q16_8: return &encode_fixed<16, 8>;
+        case SerialLoggerTypeCode::Q8_16: return &encode_fixed<8, 16>;
+        case SerialLoggerTypeCode::Q15_16: return &encode_fixed<15, 16>;
+        case SerialLoggerTypeCode::Q16_16: return &encode_fixed<16, 16>;
+        case SerialLoggerTypeCode::Q24_8: return &encode_fixed<24, 8>;
+        case SerialLoggerTypeCode::Q8_24: return &encode_fixed<8, 24>;
+        case SerialLoggerTypeCode::Q31_32: return &encode_fixed<31, 32>;
+        case SerialLoggerTypeCode::Q32_32: return &encode_fixed<32, 32>;
+        default: return nullptr;
+    }
+}
+
 SerialLoggerTypeCode SerialLoggerEncoder::parse_type(const char* type_str) const {
     if (strcmp(type_str, "u8") == 0) return SerialLoggerTypeCode::U8;
     if (strcmp(type_str, "u16") == 0) return SerialLoggerTypeCode::U16;
@@ -126,6 +189,11 @@ SerialLoggerTypeCode SerialLoggerEncoder::parse_type(const char* type_str) const
 }
 
 bool SerialLoggerEncoder::register_schema(uint8_t message_id, const char* schema_str) {
+    if ((message_id & 0x7F) == SERIAL_LOGGER_BATCH_ID) {
+        printf("Message ID 0x%02X is reserved for batches\n", message_id);
+        return false;
+    }
+
     SerialLoggerSchema schema;
     schema.message_id = message_id | 0x80;
     
@@ -171,23 +239,66 @@ bool SerialLoggerEncoder::register_schema(uint8_t message_id, const char* schema
             field.name = name_str;
         }
         
+        if (type_str[0] == 'd') {
+            field.delta = true;
+            type_str++;
+        }
+
         field.type = parse_type(type_str);
         if (field.type == SerialLoggerTypeCode::UNKNOWN) {
             printf("Unknown type: %s\n", type_str);
             return false;
         }
+
+        if (field.delta && (field.type == SerialLoggerTypeCode::F32 || field.type == SerialLoggerTypeCode::F64)) {
+            printf("Floats can't be delta encoded, use a Q format: %s\n", type_str);
+            return false;
+        }
         
         schema.fields.push_back(field);
         
         token = strtok(NULL, ",");
     }
     
-    if (schema.get_total_size() > MAX_DATA_BYTES) {
-        printf("Schema too large: %zu bytes (max %d)\n", schema.get_total_size(), MAX_DATA_BYTES);
+    bool compressed = false;
+    size_t max_size = 1;
+    for (const SerialLoggerField& field : schema.fields) {
+        compressed |= field.delta;
+        max_size += field.delta ? Varint::max_size(field.get_size()) : field.get_size();
+    }
+    if (!compressed) {
+        max_size = schema.get_total_size();
+    }
+
+    if (max_size > MAX_DATA_BYTES) {
+        printf("Schema too large: %zu bytes (max %d)\n", max_size, MAX_DATA_BYTES);
         return false;
     }
     
-    schemas[message_id & 0x7F] = schema;
+    SerialLoggerCompiledSchema& compiled = schemas[message_id & 0x7F];
+    compiled.slots.clear();
+    size_t offset = 0;
+    for (const SerialLoggerField& field : schema.fields) {
+        SerialLoggerFieldSlot slot;
+        slot.encode = encoder_for(field.type);
+        slot.offset = (uint8_t)offset;
+        slot.size = (uint8_t)field.get_size();
+        slot.type = field.type;
+        slot.delta = field.delta;
+        slot.is_signed = field.type != SerialLoggerTypeCode::U8 && field.type != SerialLoggerTypeCode::U16 &&
+                         field.type != SerialLoggerTypeCode::U32 && field.type != SerialLoggerTypeCode::U64;
+        slot.previous = 0;
+        compiled.slots.push_back(slot);
+        offset += slot.size;
+    }
+    compiled.total_size = offset;
+    compiled.compressed = compressed;
+    compiled.max_size = max_size;
+    compiled.since_keyframe = 0;
+    compiled.sequence = 0;
+    compiled.force_keyframe = true;
+    compiled.schema = schema;
+    compiled.registered = true;
     
     printf("Registered schema for message ID 0x%02X (%zu fields, %zu bytes)\n", 
            message_id & 0x7F, schema.fields.size(), schema.get_total_size());
@@ -196,121 +307,69 @@ bool SerialLoggerEncoder::register_schema(uint8_t message_id, const char* schema
 }
 
 const SerialLoggerSchema* SerialLoggerEncoder::get_schema(uint8_t message_id) const {
-    auto it = schemas.find(message_id & 0x7F);
-    if (it != schemas.end()) {
-        return &it->second;
-    }
-    return nullptr;
+    const SerialLoggerCompiledSchema* compiled = get_compiled_schema(message_id);
+    return compiled ? &compiled->schema : nullptr;
 }
 
-size_t SerialLoggerEncoder::serialize_value(uint8_t* buffer, const SerialLoggerField& field, double value) const {
-    size_t size = field.get_size();
-    
-    switch (field.type) {
-        case SerialLoggerTypeCode::U8: {
-            uint8_t v = (uint8_t)value;
-            buffer[0] = v;
-            break;
-        }
-        case SerialLoggerTypeCode::U16: {
-            uint16_t v = (uint16_t)value;
-            buffer[0] = v & 0xFF;
-            buffer[1] = (v >> 8) & 0xFF;
-            break;
-        }
-        case SerialLoggerTypeCode::U32: {
-            uint32_t v = (uint32_t)value;
-            buffer[0] = v & 0xFF;
-            buffer[1] = (v >> 8) & 0xFF;
-            buffer[2] = (v >> 16) & 0xFF;
-            buffer[3] = (v >> 24) & 0xFF;
-            break;
-        }
-        case SerialLoggerTypeCode::U64: {
-            uint64_t v = (uint64_t)value;
-            for (int i = 0; i < 8; i++) {
-                buffer[i] = (v >> (i * 8)) & 0xFF;
-            }
-            break;
-        }
-        
-        case SerialLoggerTypeCode::I8: {
-            int8_t v = (int8_t)value;
-            buffer[0] = v;
-            break;
-        }
-        case SerialLoggerTypeCode::I16: {
-            int16_t v = (int16_t)value;
-            buffer[0] = v & 0xFF;
-            buffer[1] = (v >> 8) & 0xFF;
-            break;
-        }
-        case SerialLoggerTypeCode::I32: {
-            int32_t v = (int32_t)value;
-            buffer[0] = v & 0xFF;
-            buffer[1] = (v >> 8) & 0xFF;
-            buffer[2] = (v >> 16) & 0xFF;
-            buffer[3] = (v >> 24) & 0xFF;
-            break;
+size_t SerialLoggerEncoder::compress(SerialLoggerCompiledSchema& compiled, const uint8_t* fixed, uint8_t* output) {
+    bool keyframe = compiled.force_keyframe || compiled.since_keyframe >= compiled.keyframe_interval;
+    compiled.force_keyframe = false;
+    compiled.since_keyframe = keyframe ? 1 : compiled.since_keyframe + 1;
+
+    output[0] = (keyframe ? 0x80 : 0x00) | compiled.sequence;
+    compiled.sequence = (compiled.sequence + 1) & 0x7F;
+
+    size_t length = 1;
+    for (SerialLoggerFieldSlot& slot : compiled.slots) {
+        const uint8_t* field = fixed + slot.offset;
+        if (!slot.delta) {
+            memcpy(output + length, field, slot.size);
+            length += slot.size;
+            continue;
         }
-        case SerialLoggerTypeCode::I64: {
-            int64_t v = (int64_t)value;
-            for (int i = 0; i < 8; i++) {
-                buffer[i] = (v >> (i * 8)) & 0xFF;
+
+        uint64_t value = 0;
+        memcpy(&value, field, slot.size);
+        const uint64_t mask = slot.size == 8 ? ~0ULL : (1ULL << (slot.size * 8)) - 1;
+        uint64_t delta = (value - (keyframe ? 0 : slot.previous)) & mask;
+        slot.previous = value;
+
+        if (slot.is_signed) {
+            // Sign extend the difference from the field width
+            if (delta & (1ULL << (slot.size * 8 - 1))) {
+                delta |= ~mask;
             }
-            break;
-        }
-        
-        case SerialLoggerTypeCode::F32: {
-            float v = (float)value;
-            uint32_t bits;
-            memcpy(&bits, &v, sizeof(float));
-            buffer[0] = bits & 0xFF;
-            buffer[1] = (bits >> 8) & 0xFF;
-            buffer[2] = (bits >> 16) & 0xFF;
-            buffer[3] = (bits >> 24) & 0xFF;
-            break;
+            length += Varint::encode(Varint::zigzag((int64_t)delta), output + length);
+        } else {
+            length += Varint::encode(delta, output + length);
         }
-        case SerialLoggerTypeCode::F64: {
-            uint64_t bits;
-            memcpy(&bits, &value, sizeof(double));
-            for (int i = 0; i < 8; i++) {
-                buffer[i] = (bits >> (i * 8)) & 0xFF;
-            }
-            break;
+    }
+    return length;
+}
+
+size_t SerialLoggerEncoder::encode_payload(SerialLoggerCompiledSchema& compiled, const double* values, uint8_t* output) {
+    const SerialLoggerFieldSlot* slots = compiled.slots.data();
+    const size_t num_slots = compiled.slots.size();
+
+    if (!compiled.compressed) {
+        for (size_t i = 0; i < num_slots; i++) {
+            slots[i].encode(output + slots[i].offset, values[i]);
         }
-        
-        case SerialLoggerTypeCode::Q3_4: { QNumber3_4 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q4_4: { QNumber4_4 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q7_1: { QNumber7_1 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q1_7: { QNumber1_7 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q6_2: { QNumber6_2 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q2_6: { QNumber2_6 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q7_8: { QNumber7_8 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q8_8: { QNumber8_8 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q15_1: { QNumber15_1 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q1_15: { QNumber1_15 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q9_6: { QNumber9_6 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q10_6: { QNumber10_6 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q12_12: { QNumber12_12 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q16_8: { QNumber16_8 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q8_16: { QNumber8_16 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q15_16: { QNumber15_16 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q16_16: { QNumber16_16 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q24_8: { QNumber24_8 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q8_24: { QNumber8_24 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q31_32: { QNumber31_32 q(value); q.toBytes(buffer); break; }
-        case SerialLoggerTypeCode::Q32_32: { QNumber32_32 q(value); q.toBytes(buffer); break; }
-        
-        default:
-            return 0;
+        return compiled.total_size;
     }
-    
-    return size;
+
+    uint8_t fixed[MAX_DATA_BYTES];
+    for (size_t i = 0; i < num_slots; i++) {
+        slots[i].encode(fixed + slots[i].offset, values[i]);
+    }
+    return compress(compiled, fixed, output);
 }
 
 size_t SerialLoggerEncoder::encode_schema_packet(uint8_t message_id, const char* schema_str, uint8_t* output) {
     uint8_t raw_buffer[MAX_DATA_BYTES + 3];
+
+    // The host starts the message over, so deltas have to as well
+    force_keyframe(message_id);
     
     raw_buffer[0] = message_id | 0x80;
     
@@ -332,14 +391,14 @@ size_t SerialLoggerEncoder::encode_schema_packet(uint8_t message_id, const char*
 }
 
 size_t SerialLoggerEncoder::encode_data_packet(uint8_t message_id, const double* values, size_t numValues, uint8_t* output) {
-    const SerialLoggerSchema* schema = get_schema(message_id);
-    if (!schema) {
+    SerialLoggerCompiledSchema* compiled = compiled_schema(message_id);
+    if (!compiled) {
         printf("No schema for message ID 0x%02X\n", message_id);
         return 0;
     }
     
-    if (numValues != schema->fields.size()) {
-        printf("Value count mismatch: got %zu, expected %zu\n", numValues, schema->fields.size());
+    if (numValues != compiled->slots.size()) {
+        printf("Value count mismatch: got %zu, expected %zu\n", numValues, compiled->slots.size());
         return 0;
     }
     
@@ -347,10 +406,7 @@ size_t SerialLoggerEncoder::encode_data_packet(uint8_t message_id, const double*
     
     raw_buffer[0] = message_id & 0x7F;
     
-    size_t offset = 1;
-    for (size_t i = 0; i < numValues; i++) {
-        offset += serialize_value(raw_buffer + offset, schema->fields[i], values[i]);
-    }
+    size_t offset = 1 + encode_payload(*compiled, values, raw_buffer + 1);
     
     CRC16::append(raw_buffer, offset);
     offset += 2;
@@ -361,15 +417,37 @@ size_t SerialLoggerEncoder::encode_data_packet(uint8_t message_id, const double*
     return cobs_len + 1;
 }
 
+bool SerialLoggerEncoder::encode_data_record(uint8_t message_id, const double* values, size_t numValues, SerialLoggerBatch& batch) {
+    SerialLoggerCompiledSchema* compiled = compiled_schema(message_id);
+    if (!compiled) {
+        printf("No schema for message ID 0x%02X\n", message_id);
+        return false;
+    }
+
+    if (numValues != compiled->slots.size()) {
+        printf("Value count mismatch: got %zu, expected %zu\n", numValues, compiled->slots.size());
+        return false;
+    }
+
+    const size_t reserved = compiled->compressed ? compiled->max_size : compiled->total_size;
+    uint8_t* payload = batch.reserve(message_id, reserved);
+    if (!payload) {
+        return false;
+    }
+
+    batch.trim_last(reserved, encode_payload(*compiled, values, payload));
+    return true;
+}
+
 // =============================================================================
 // SerialLoggerDataBuilder Implementation
 // =============================================================================
 
 SerialLoggerEncoder::SerialLoggerDataBuilder::SerialLoggerDataBuilder(SerialLoggerEncoder* enc, uint8_t message_id) 
-    : encoder(enc), offset(1), field_index(0) {
+    : field_index(0) {
     
-    schema = encoder->get_schema(message_id);
-    if (!schema) {
+    compiled = enc->compiled_schema(message_id);
+    if (!compiled) {
         printf("No schema for message ID 0x%02X\n", message_id);
         return;
     }
@@ -378,44 +456,41 @@ SerialLoggerEncoder::SerialLoggerDataBuilder::SerialLoggerDataBuilder(SerialLogg
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(uint8_t value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
+    slot->encode(raw_buffer + 1 + slot->offset, (double)value);
     field_index++;
     return *this;
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(uint16_t value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
+    slot->encode(raw_buffer + 1 + slot->offset, (double)value);
     field_index++;
     return *this;
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(uint32_t value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
+    slot->encode(raw_buffer + 1 + slot->offset, (double)value);
     field_index++;
     return *this;
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(uint64_t value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
-    
-    const SerialLoggerField& field = schema->fields[field_index];
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    if (field.type == SerialLoggerTypeCode::U64) {
-        for (int i = 0; i < 8; i++) {
-            raw_buffer[offset + i] = (value >> (i * 8)) & 0xFF;
-        }
-        offset += 8;
+    // Don't round trip through a double, timestamps need all 64 bits
+    if (slot->type == SerialLoggerTypeCode::U64) {
+        memcpy(raw_buffer + 1 + slot->offset, &value, sizeof(value));
     } else {
-        offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
+        slot->encode(raw_buffer + 1 + slot->offset, (double)value);
     }
     
     field_index++;
@@ -423,44 +498,40 @@ SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerD
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(int8_t value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
+    slot->encode(raw_buffer + 1 + slot->offset, (double)value);
     field_index++;
     return *this;
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(int16_t value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
+    slot->encode(raw_buffer + 1 + slot->offset, (double)value);
     field_index++;
     return *this;
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(int32_t value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
+    slot->encode(raw_buffer + 1 + slot->offset, (double)value);
     field_index++;
     return *this;
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(int64_t value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    
-    if (field.type == SerialLoggerTypeCode::I64) {
-        for (int i = 0; i < 8; i++) {
-            raw_buffer[offset + i] = (value >> (i * 8)) & 0xFF;
-        }
-        offset += 8;
+    if (slot->type == SerialLoggerTypeCode::I64) {
+        memcpy(raw_buffer + 1 + slot->offset, &value, sizeof(value));
     } else {
-        offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
+        slot->encode(raw_buffer + 1 + slot->offset, (double)value);
     }
     
     field_index++;
@@ -468,35 +539,47 @@ SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerD
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(float value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
+    
+    if (slot->type == SerialLoggerTypeCode::F32) {
+        memcpy(raw_buffer + 1 + slot->offset, &value, sizeof(value));
+    } else {
+        slot->encode(raw_buffer + 1 + slot->offset, (double)value);
+    }
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    offset += encoder->serialize_value(raw_buffer + offset, field, (double)value);
     field_index++;
     return *this;
 }
 
 SerialLoggerEncoder::SerialLoggerDataBuilder& SerialLoggerEncoder::SerialLoggerDataBuilder::add(double value) {
-    if (!schema || field_index >= schema->fields.size()) return *this;
+    const SerialLoggerFieldSlot* slot = next_slot();
+    if (!slot) return *this;
     
-    const SerialLoggerField& field = schema->fields[field_index];
-    offset += encoder->serialize_value(raw_buffer + offset, field, value);
+    slot->encode(raw_buffer + 1 + slot->offset, value);
     field_index++;
     return *this;
 }
 
 size_t SerialLoggerEncoder::SerialLoggerDataBuilder::send(uint8_t* output) {
-    if (!schema) {
+    if (!compiled) {
         printf("Invalid builder: no schema\n");
         return 0;
     }
     
-    if (field_index != schema->fields.size()) {
+    if (field_index != compiled->slots.size()) {
         printf("Field count mismatch: added %zu, expected %zu\n", 
-               field_index, schema->fields.size());
+               field_index, compiled->slots.size());
         return 0;
     }
     
+    size_t offset = 1 + compiled->total_size;
+    if (compiled->compressed) {
+        uint8_t fixed[MAX_DATA_BYTES];
+        memcpy(fixed, raw_buffer + 1, compiled->total_size);
+        offset = 1 + compress(*compiled, fixed, raw_buffer + 1);
+    }
+
     CRC16::append(raw_buffer, offset);
     offset += 2;
     
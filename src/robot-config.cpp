@@ -1,10 +1,12 @@
 #include "robot-config.h"
+#include "competition/autonomous.h"
 #include "core/subsystems/odometry/odometry_lidar_wrapper.h"
 #include "core/subsystems/screen.h"
 #include "core/units/types/geometry.h"
 #include "core/utils/command_structure/auto_command.h"
 #include "core/utils/controls/feedforward.h"
 #include "core/utils/controls/motion_controller.h"
+#include "core/utils/controls/state_space/ltv_gain_table_cache.h"
 #include "core/utils/controls/state_space/tank_drive_sysid.h"
 #include "core/utils/math/geometry/rotation2d.h"
 #include "core/utils/controls/pidff.h"
@@ -131,6 +133,15 @@ TankTrajectoryFollowerConfig line_cfg = [] {
 }();
 
 SerialLogger logger(vex::PORT12);
+
+struct PoseLogMessage : SerialLoggerMessage<PoseLogMessage, 0x01, uint64_t, float, float, float> {
+  static constexpr const char *field_names() { return "time, x, y, t"; }
+};
+
+struct WheelVelocityLogMessage : SerialLoggerMessage<WheelVelocityLogMessage, 0x02, uint64_t, float, float> {
+  static constexpr const char *field_names() { return "time, l, r"; }
+};
+FieldRangeTable field_ranges(FIELD_SIZE);
 LidarReceiver lidar(vex::PORT15, 921600, &imu, &left_motors, &right_motors, &config, &logger, &drive_observer);
 
 OdometryLidarWrapper odom(&lidar);
@@ -176,6 +187,8 @@ void robot_init() {
  while (!logger.is_connected() && (vexSystemHighResTimeGet() - init_us) < 5000000) {
    logger.update();
  }
+ // Lidar and trajectory logging happen inside control loops, keep the UART off those threads
+ logger.start_async();
 
  while(imu.isCalibrating()){
     vexDelay(10);
@@ -197,6 +210,13 @@ void robot_init() {
       });
     drive_observer.start_async();
 
+  // Load (or solve once and save) the trajectory follower gains so starting a path is just a lookup
+  LTVGainTableCache::load_from_sd();
+  LTVGainTableCache::get(drive_model.wheel_plant(), drive_model.trackwidth(), trajectory_follower_config);
+  LTVGainTableCache::get(drive_model.wheel_plant(), drive_model.trackwidth(), line_cfg);
+  LTVGainTableCache::save_to_sd();
+  precompute_trajectories();
+
   std::vector<screen::Page *> pages = {
     new screen::StatsPage({
       {"left1", left1},
@@ -249,6 +269,12 @@ void robot_init() {
   // }
 
 
+  // Built once and kept on the SD card, after that this is a ~1.9MB file read.
+  // On the first boot with a new map (or no SD card) the whole table is ray
+  // cast right here, blocking robot_init for seconds, the time is printed
+  field_ranges.load_or_build(lidar_ukf::field_map());
+  lidar_ukf::use_field_ranges(&field_ranges);
+
   init_us = vexSystemHighResTimeGet();
   
   lidar.start();
@@ -264,8 +290,8 @@ void robot_init() {
     }
 
     if (!logger_schema_sent) {
-      logger.define_and_send_schema(0x01, "time:u64, x:f32, y:f32, t:f32");
-      logger.define_and_send_schema(0x02, "time:u64, l:f32, r:f32");
+      logger.send_message_schema<PoseLogMessage>();
+      logger.send_message_schema<WheelVelocityLogMessage>();
       logger_schema_sent = true;
     }
 
@@ -277,14 +303,10 @@ void robot_init() {
     float t((float)pose.rotation().wrapped_degrees_360());
     float l((float)drive_sys.get_left_velocity());
     float r((float)drive_sys.get_right_velocity());
-    logger.build(0x01)
-       .add(timestamp)
-       .add(x)
-       .add(y)
-       .add(t)
-       .send();
-    const double observer_data[3] = {(double)timestamp, (double)l, (double)r};
-    logger.log(0x02, observer_data, 3);
+    SerialLogger::Batch batch = logger.batch();
+    batch.add<PoseLogMessage>(timestamp, x, y, t);
+    batch.add<WheelVelocityLogMessage>(timestamp, l, r);
+    batch.send();
     // printf("loop\n");
     vexDelay(10);
   }
@@ -0,0 +1,255 @@
+#include "subsystems/FieldMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+
+#include "vex.h"
+
+constexpr uint16_t FieldRangeTable::FILE_VERSION;
+constexpr double FieldRangeTable::MAX_RANGE;
+constexpr double FieldRangeTable::EDGE_SPREAD;
+constexpr double FieldRangeTable::EDGE_SPREAD_PER_INCH;
+
+// File layout (little endian, as stored by the brain)
+/*
+ * +------------- header --------------+
+ * | magic "FRNG" | version:u16 | angle_bins:u16 | nodes:u32 | cell_size:f64 | fingerprint:u64 |
+ * +-----------------------------------+
+ * | ranges: u16 Q10.6 inches, [y][x][heading] |
+ * +-----------------------------------+
+ */
+
+namespace {
+const char kMagic[4] = {'F', 'R', 'N', 'G'};
+constexpr size_t kHeaderSize = 4 + 2 + 2 + 4 + 8 + 8;
+
+inline double cross(double ax, double ay, double bx, double by) { return ax * by - ay * bx; }
+
+// FNV-1a
+void hash_bytes(uint64_t& hash, const void* data, size_t len) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+}
+} // namespace
+
+void FieldMap::add_segment(double x0, double y0, double x1, double y1) {
+    segments_.push_back({x0, y0, x1, y1});
+}
+
+void FieldMap::add_box(double cx, double cy, double width, double height, double angle) {
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+    const double hw = width / 2.0;
+    const double hh = height / 2.0;
+
+    double xs[4], ys[4];
+    const double corners[4][2] = {{-hw, -hh}, {hw, -hh}, {hw, hh}, {-hw, hh}};
+    for (int i = 0; i < 4; i++) {
+        xs[i] = cx + corners[i][0] * c - corners[i][1] * s;
+        ys[i] = cy + corners[i][0] * s + corners[i][1] * c;
+    }
+    for (int i = 0; i < 4; i++) {
+        add_segment(xs[i], ys[i], xs[(i + 1) % 4], ys[(i + 1) % 4]);
+    }
+}
+
+double FieldMap::ray_cast(double x, double y, double heading, double max_range) const {
+    const double dx = std::cos(heading);
+    const double dy = std::sin(heading);
+    double best = max_range;
+
+    for (const Segment& seg : segments_) {
+        const double ex = seg.x1 - seg.x0;
+        const double ey = seg.y1 - seg.y0;
+        const double denom = cross(dx, dy, ex, ey);
+        if (std::abs(denom) < 1e-12) {
+            continue; // parallel
+        }
+        const double wx = seg.x0 - x;
+        const double wy = seg.y0 - y;
+        const double t = cross(wx, wy, ex, ey) / denom;
+        const double s = cross(wx, wy, dx, dy) / denom;
+        if (t >= 0 && s >= 0 && s <= 1 && t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+uint64_t FieldMap::fingerprint() const {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const Segment& seg : segments_) {
+        hash_bytes(hash, &seg, sizeof(seg));
+    }
+    return hash;
+}
+
+FieldRangeTable::FieldRangeTable(double field_size, double cell_size, int angle_bins)
+    : cell_size_(cell_size), nodes_((int)std::ceil(field_size / cell_size) + 1), angle_bins_(angle_bins) {}
+
+void FieldRangeTable::build(const FieldMap& map) {
+    printf("FieldRangeTable: building %dx%dx%d table\n", nodes_, nodes_, angle_bins_);
+    const uint32_t start_ms = vexSystemTimeGet();
+    ranges_.assign((size_t)nodes_ * nodes_ * angle_bins_, 0);
+
+    for (int iy = 0; iy < nodes_; iy++) {
+        for (int ix = 0; ix < nodes_; ix++) {
+            for (int bin = 0; bin < angle_bins_; bin++) {
+                const double heading = bin * 2.0 * M_PI / angle_bins_;
+                const double r = map.ray_cast(ix * cell_size_, iy * cell_size_, heading, MAX_RANGE);
+                ranges_[index(ix, iy, bin)] = (uint16_t)std::lround(r * 64.0);
+            }
+        }
+        // Don't starve everything else while this runs in robot_init
+        vex::this_thread::yield();
+    }
+    fingerprint_ = map.fingerprint();
+    map_ = map;
+    printf("FieldRangeTable: built in %lu ms\n", (unsigned long)(vexSystemTimeGet() - start_ms));
+}
+
+bool FieldRangeTable::contains(double x, double y) const {
+    const double max = (nodes_ - 1) * cell_size_;
+    return ready() && x >= 0 && y >= 0 && x < max && y < max;
+}
+
+double FieldRangeTable::range(double x, double y, double heading) const {
+    const double gx = x / cell_size_;
+    const double gy = y / cell_size_;
+    double ga = heading / (2.0 * M_PI) * angle_bins_;
+    ga -= std::floor(ga / angle_bins_) * angle_bins_;
+
+    const int ix = (int)gx;
+    const int iy = (int)gy;
+    const int a0 = (int)ga % angle_bins_;
+    const int a1 = (a0 + 1) % angle_bins_;
+    const double fx = gx - ix;
+    const double fy = gy - iy;
+    const double fa = ga - std::floor(ga);
+
+    // The two headings of one grid point are next to each other in memory
+    uint16_t lo = 0xFFFF, hi = 0;
+    double corners[4];
+    for (int i = 0; i < 4; i++) {
+        const uint16_t* node = &ranges_[index(ix + (i & 1), iy + (i >> 1), 0)];
+        lo = std::min(lo, std::min(node[a0], node[a1]));
+        hi = std::max(hi, std::max(node[a0], node[a1]));
+        corners[i] = node[a0] + fa * (node[a1] - node[a0]);
+    }
+
+    // The samples straddle the edge of something, blending them would make up
+    // a range that isn't there
+    if ((hi - lo) / 64.0 > EDGE_SPREAD + EDGE_SPREAD_PER_INCH * (lo / 64.0)) {
+        return map_.ray_cast(x, y, heading, MAX_RANGE);
+    }
+
+    const double bottom = corners[0] + fx * (corners[1] - corners[0]);
+    const double top = corners[2] + fx * (corners[3] - corners[2]);
+    return (bottom + fy * (top - bottom)) / 64.0;
+}
+
+bool FieldRangeTable::load_from_sd(const FieldMap& map, const std::string& filename) {
+    vex::brain::sdcard sd;
+    if (!sd.isInserted()) {
+        printf("!! Trying to load field ranges from No SD Card !!\n");
+        return false;
+    }
+    if (!sd.exists(filename.c_str())) {
+        printf("FieldRangeTable: %s does not exist yet\n", filename.c_str());
+        return false;
+    }
+
+    const size_t count = (size_t)nodes_ * nodes_ * angle_bins_;
+    const int32_t size = sd.size(filename.c_str());
+    if (size != (int32_t)(kHeaderSize + count * sizeof(uint16_t))) {
+        printf("FieldRangeTable: %s is for a different grid, rebuilding\n", filename.c_str());
+        return false;
+    }
+
+    std::vector<unsigned char> data(size);
+    const int32_t readsize = sd.loadfile(filename.c_str(), &data[0], size);
+    if (readsize != size) {
+        printf("!! Error reading from `%s` !!\n", filename.c_str());
+        return false;
+    }
+    const unsigned char* header = &data[0];
+
+    uint16_t version, angle_bins;
+    uint32_t nodes;
+    double cell_size;
+    uint64_t fingerprint;
+    size_t pos = sizeof(kMagic);
+    memcpy(&version, header + pos, sizeof(version));
+    pos += sizeof(version);
+    memcpy(&angle_bins, header + pos, sizeof(angle_bins));
+    pos += sizeof(angle_bins);
+    memcpy(&nodes, header + pos, sizeof(nodes));
+    pos += sizeof(nodes);
+    memcpy(&cell_size, header + pos, sizeof(cell_size));
+    pos += sizeof(cell_size);
+    memcpy(&fingerprint, header + pos, sizeof(fingerprint));
+
+    if (memcmp(header, kMagic, sizeof(kMagic)) != 0 || version != FILE_VERSION || angle_bins != angle_bins_ ||
+        nodes != (uint32_t)nodes_ || cell_size != cell_size_ || fingerprint != map.fingerprint()) {
+        printf("FieldRangeTable: %s is stale, rebuilding\n", filename.c_str());
+        return false;
+    }
+
+    ranges_.resize(count);
+    memcpy(&ranges_[0], &data[kHeaderSize], count * sizeof(uint16_t));
+    fingerprint_ = fingerprint;
+    map_ = map;
+    printf("FieldRangeTable: loaded %s\n", filename.c_str());
+    return true;
+}
+
+bool FieldRangeTable::save_to_sd(const std::string& filename) const {
+    if (!ready()) {
+        return false;
+    }
+
+    std::vector<unsigned char> data(kHeaderSize + ranges_.size() * sizeof(uint16_t));
+    const uint16_t version = FILE_VERSION;
+    const uint16_t angle_bins = (uint16_t)angle_bins_;
+    const uint32_t nodes = (uint32_t)nodes_;
+    size_t pos = 0;
+    memcpy(&data[pos], kMagic, sizeof(kMagic));
+    pos += sizeof(kMagic);
+    memcpy(&data[pos], &version, sizeof(version));
+    pos += sizeof(version);
+    memcpy(&data[pos], &angle_bins, sizeof(angle_bins));
+    pos += sizeof(angle_bins);
+    memcpy(&data[pos], &nodes, sizeof(nodes));
+    pos += sizeof(nodes);
+    memcpy(&data[pos], &cell_size_, sizeof(cell_size_));
+    pos += sizeof(cell_size_);
+    memcpy(&data[pos], &fingerprint_, sizeof(fingerprint_));
+    pos += sizeof(fingerprint_);
+    memcpy(&data[pos], &ranges_[0], ranges_.size() * sizeof(uint16_t));
+
+    vex::brain::sdcard sd;
+    if (!sd.isInserted()) {
+        printf("!! Trying to save field ranges to No SD Card !!\n");
+        return false;
+    }
+
+    const int32_t written = sd.savefile(filename.c_str(), &data[0], data.size());
+    if (written != (int32_t)data.size()) {
+        printf("!! Error writing to `%s` !!\n", filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+void FieldRangeTable::load_or_build(const FieldMap& map, const std::string& filename) {
+    if (load_from_sd(map, filename)) {
+        return;
+    }
+    build(map);
+    save_to_sd(filename);
+}
@@ -8,112 +8,6 @@
 #include <vex_global.h>
 #include <vex_units.h>
 
-namespace {
-    // somehow the one in rotation2d is fucked
-    inline double wrap_radians(double angle) {
-        while (angle > M_PI) angle -= 2.0 * M_PI;
-        while (angle < -M_PI) angle += 2.0 * M_PI;
-        return angle;
-    }
-}
-
-namespace lidar_ukf {
-    // all this does for now is transform from robot to field frame
-    // should be the same regardless of data source, but odom would be better
-    EVec<3> dynamics(const EVec<3>& x, const EVec<3>& u) {
-        double theta = x(2);
-        double c = std::cos(theta);
-        double s = std::sin(theta);
-        
-        double vx_field = u(0) * c - u(1) * s;
-        double vy_field = u(0) * s + u(1) * c;
-        
-        return EVec<3>{vx_field, vy_field, u(2)};
-    }
-    
-    EVec<2> measurement(const EVec<3>& xhat, const EVec<3>& u) {
-        double robot_x = xhat(0);
-        double robot_y = xhat(1);
-        double robot_theta = xhat(2);
-        
-        // transofrm lidar position to field
-        double cos_theta = std::cos(robot_theta);
-        double sin_theta = std::sin(robot_theta);
-        double lidar_x = robot_x + LIDAR_OFFSET_X * cos_theta - LIDAR_OFFSET_Y * sin_theta;
-        double lidar_y = robot_y + LIDAR_OFFSET_X * sin_theta + LIDAR_OFFSET_Y * cos_theta;
-        
-        // direction in field frame
-        double beam_theta = robot_theta + LIDAR_OFFSET_ANGLE + u(1) * M_PI / 180.0;
-        
-        double c = std::cos(beam_theta);
-        double s = std::sin(beam_theta);
-        
-        double d_left = (c < 0) ? ((lidar_x - WALL_MIN) / -c) : 1e9;
-        double d_right = (c > 0) ? ((WALL_MAX - lidar_x) / c) : 1e9;
-        double d_bottom = (s < 0) ? ((lidar_y - WALL_MIN) / -s) : 1e9;
-        double d_top = (s > 0) ? ((WALL_MAX - lidar_y) / s) : 1e9;
-        
-        double min_dist = std::min({d_left, d_right, d_bottom, d_top});
-        
-        return EVec<2>{min_dist, u(1)};
-    }
-    
-    EVec<3> mean_state(const EMat<3, 5>& sigmas, const EVec<5>& Wm) {
-        EVec<3> x = EVec<3>::Zero();
-        double c = 0, s = 0;
-        
-        for (int i = 0; i < 5; i++) {
-            x(0) += sigmas(0, i) * Wm(i);
-            x(1) += sigmas(1, i) * Wm(i);
-            c += std::cos(sigmas(2, i)) * Wm(i);
-            s += std::sin(sigmas(2, i)) * Wm(i);
-        }
-        x(2) = std::atan2(s, c);
-        return x;
-    }
-    
-    EVec<2> mean_meas(const EMat<2, 5>& sigmas, const EVec<5>& Wm) {
-        EVec<2> y = EVec<2>::Zero();
-        double c = 0, s = 0;
-        
-        for (int i = 0; i < 5; i++) {
-            y(0) += sigmas(0, i) * Wm(i);
-            c += std::cos(sigmas(1, i) * M_PI / 180.0) * Wm(i);
-            s += std::sin(sigmas(1, i) * M_PI / 180.0) * Wm(i);
-        }
-        y(1) = std::atan2(s, c) * 180.0 / M_PI;
-        return y;
-    }
-    
-    EVec<3> residual_state(const EVec<3>& a, const EVec<3>& b) {
-        return EVec<3>{a(0) - b(0), a(1) - b(1), wrap_radians(a(2) - b(2))};
-    }
-    
-    EVec<2> residual_meas(const EVec<2>& a, const EVec<2>& b) {
-        double angle_diff = a(1) - b(1);
-        while (angle_diff > 180.0) angle_diff -= 360.0;
-        while (angle_diff < -180.0) angle_diff += 360.0;
-        return EVec<2>{a(0) - b(0), angle_diff};
-    }
-    
-    EVec<3> add_state(const EVec<3>& a, const EVec<3>& b) {
-        return EVec<3>{a(0) + b(0), a(1) + b(1), wrap_radians(a(2) + b(2))};
-    }
-    
-    UnscentedKalmanFilter<3, 3, 2> createUKF() {
-        EVec<3> state_stddevs{2.0, 2.0, 0.01};
-        
-        EVec<2> measurement_stddevs{20, 20};
-        
-        return UnscentedKalmanFilter<3, 3, 2>(
-            dynamics, measurement, RK2_with_input<3, 3>,
-            state_stddevs, measurement_stddevs,
-            mean_state, mean_meas,
-            residual_state, residual_meas, add_state
-        );
-    }
-}
-
 LidarReceiver::LidarReceiver(
   int port,
   int baudrate,
@@ -123,7 +17,7 @@ LidarReceiver::LidarReceiver(
   robot_specs_t *config,
   SerialLogger *logger,
   TankDriveObserver *drive_observer)
-    : COBSSerialDevice(port, baudrate),
+    : COBSSerialDevice(port, baudrate, LIDAR_BEAM_HZ),
       imu(imu),
       left_motors(left_motors),
       right_motors(right_motors),
@@ -180,6 +74,34 @@ void LidarReceiver::reset_ukf(const Pose2d& initial_pose) {
     ukf_.set_P(initialP);
     
     last_predict_us_ = vexSystemHighResTimeGet() - init_us;
+    // beams gathered against the old pose
+    batch_count_ = 0;
+}
+
+void LidarReceiver::set_batching(bool enabled, int batch_size, double max_latency_ms) {
+    batching_ = enabled;
+    batch_size_ = std::max(1, std::min(batch_size, LIDAR_MAX_BATCH));
+    batch_latency_us_ = (uint64_t)(max_latency_ms * 1000.0);
+}
+
+void LidarReceiver::predict_to(uint64_t now_us) {
+    double dt = (now_us - last_predict_us_) / 1.0e6;
+    if (dt > 0) {
+        EVec<3> velocity = get_robot_velocity();
+        ukf_.predict(velocity, dt);
+        last_predict_us_ = now_us;
+    }
+}
+
+void LidarReceiver::correct_batch() {
+    if (batch_count_ == 0) {
+        return;
+    }
+
+    predict_to(vexSystemHighResTimeGet() - init_us);
+
+    lidar_ukf::correct_batch(ukf_, batch_ranges_, batch_angles_, batch_count_);
+    batch_count_ = 0;
 }
 
 EVec<3> LidarReceiver::get_robot_velocity() {
@@ -239,9 +161,11 @@ int lidar_thread(void* ptr) {
     
     vexDelay(100);
     
-    obj.logger->define_and_send_schema(0x04, "time:u64,d:f32,a:f32");
+    // Beams are logged at full rate, so keep them small: the timestamp and
+    // angle are deltas from the previous beam and the angle is the sensor's
+    // own Q6 format
+    obj.logger->define_and_send_schema(0x04, "time:du64,d:Q10_6,a:dQ10_6");
 
-    int i = 0;
     while (obj.running_) {
         uint64_t now_us = vexSystemHighResTimeGet() - init_us;
         
@@ -253,13 +177,18 @@ int lidar_thread(void* ptr) {
             obj.last_predict_us_ = now_us;
             obj.pose_out_ = obj.get_internal_pose();
         }
+
+        // don't sit on a partial batch while the sensor is quiet or turned away
+        if (obj.batch_count_ > 0 && (!obj.batching_ || now_us - obj.batch_start_us_ >= obj.batch_latency_us_)) {
+            obj.correct_batch();
+        }
         
         // Poll for incoming lidar data
         if (obj.poll_incoming_data_once()) {
             // Got a complete packet, decode it
-            auto packet = obj.get_last_decoded_packet();
+            COBSSerialDevice::PacketView packet = obj.last_packet();
             
-            if (packet.size() != 4) {
+            if (packet.size != 4) {
                 continue;
             }
 
@@ -267,8 +196,8 @@ int lidar_thread(void* ptr) {
             
             uint16_t angle_q6;
             uint16_t dist;
-            memcpy(&angle_q6, packet.data(), sizeof(angle_q6));
-            memcpy(&dist, packet.data() + sizeof(angle_q6), sizeof(dist));
+            memcpy(&angle_q6, packet.data, sizeof(angle_q6));
+            memcpy(&dist, packet.data + sizeof(angle_q6), sizeof(dist));
             
             double angle = fmod(angle_q6 * 0.015625, 360);
             angle = wrap_degrees_360(-angle);
@@ -295,24 +224,30 @@ int lidar_thread(void* ptr) {
                 continue;
             }
 
-            // predict up to now
             uint64_t meas_time = vexSystemHighResTimeGet() - init_us;
-            double dt_meas = (meas_time - obj.last_predict_us_) / 1.0e6;
-            if (dt_meas > 0) {
-                EVec<3> velocity = obj.get_robot_velocity();
-                obj.ukf_.predict(velocity, dt_meas);
-                obj.last_predict_us_ = meas_time;
-            }
 
-            // log every other beam
-            if (i % 16 == 0) {
-                obj.logger->build(0x04)
-                    .add(meas_time)
-                    .add((float)distance)
-                    .add((float)angle)
-                    .send();
+            obj.logger->build(0x04)
+                .add(meas_time)
+                .add((float)distance)
+                .add((float)angle)
+                .send();
+
+            if (obj.batching_) {
+                if (obj.batch_count_ == 0) {
+                    obj.batch_start_us_ = meas_time;
+                }
+                obj.batch_ranges_(obj.batch_count_) = distance;
+                obj.batch_angles_(obj.batch_count_) = angle;
+                obj.batch_count_++;
+                if (obj.batch_count_ >= obj.batch_size_) {
+                    obj.correct_batch();
+                }
+                continue;
             }
 
+            // predict up to now
+            obj.predict_to(meas_time);
+
             // finally call correct
             EVec<2> measurement;
             measurement << distance, angle;
@@ -322,10 +257,17 @@ int lidar_thread(void* ptr) {
             EVec<3> u_meas{0.0, angle, 0.0};
             
             obj.ukf_.correct(u_meas, measurement);
-            i++;
+        } else {
+            // Nothing buffered. Sleep until the serial service sees more
+            // beams, or until the next predict or batch flush is due
+            uint64_t due_us = obj.last_predict_us_ + 10000;
+            if (obj.batch_count_ > 0) {
+                due_us = std::min(due_us, obj.batch_start_us_ + obj.batch_latency_us_);
+            }
+            uint64_t idle_us = vexSystemHighResTimeGet() - init_us;
+            uint32_t wait_ms = due_us > idle_us ? (uint32_t)((due_us - idle_us) / 1000) : 0;
+            obj.wait_for_data(std::max<uint32_t>(wait_ms, 1), obj.lidar_handle_);
         }
-        
-        vex::this_thread::yield();
     }
 
     return 0;
@@ -0,0 +1,177 @@
+#include "subsystems/LidarUKF.h"
+#include <algorithm>
+
+namespace {
+    // somehow the one in rotation2d is fucked
+    inline double wrap_radians(double angle) {
+        while (angle > M_PI) angle -= 2.0 * M_PI;
+        while (angle < -M_PI) angle += 2.0 * M_PI;
+        return angle;
+    }
+}
+
+namespace lidar_ukf {
+    // all this does for now is transform from robot to field frame
+    // should be the same regardless of data source, but odom would be better
+    EVec<3> dynamics(const EVec<3>& x, const EVec<3>& u) {
+        double theta = x(2);
+        double c = std::cos(theta);
+        double s = std::sin(theta);
+        
+        double vx_field = u(0) * c - u(1) * s;
+        double vy_field = u(0) * s + u(1) * c;
+        
+        return EVec<3>{vx_field, vy_field, u(2)};
+    }
+    
+    namespace {
+        const FieldRangeTable* field_ranges = nullptr;
+    }
+
+    // Element sizes are nominal, from the game manual drawings. The long
+    // goals sit above the floor on end supports, they're only mapped once
+    // LIDAR_MAP_LONG_GOALS says they were checked against the lidar's
+    // mounting height.
+    FieldMap field_map() {
+        constexpr double CENTER = (WALL_MIN + WALL_MAX) / 2.0;
+        constexpr double GOAL_ROW_OFFSET = 47.0;  // long goals and loaders, from center
+        constexpr double LONG_GOAL_LENGTH = 48.8;
+        constexpr double LONG_GOAL_WIDTH = 4.0;
+        constexpr double CENTER_GOAL_LENGTH = 22.6;
+        constexpr double CENTER_GOAL_WIDTH = 4.0;
+        constexpr double LOADER_DEPTH = 4.5;
+        constexpr double LOADER_WIDTH = 5.0;
+
+        FieldMap map;
+        map.add_segment(WALL_MIN, WALL_MIN, WALL_MAX, WALL_MIN);
+        map.add_segment(WALL_MAX, WALL_MIN, WALL_MAX, WALL_MAX);
+        map.add_segment(WALL_MAX, WALL_MAX, WALL_MIN, WALL_MAX);
+        map.add_segment(WALL_MIN, WALL_MAX, WALL_MIN, WALL_MIN);
+
+        for (double side : {-1.0, 1.0}) {
+            const double row = CENTER + side * GOAL_ROW_OFFSET;
+            if (LIDAR_MAP_LONG_GOALS) {
+                map.add_box(CENTER, row, LONG_GOAL_LENGTH, LONG_GOAL_WIDTH);
+            }
+            map.add_box(WALL_MIN + LOADER_DEPTH / 2.0, row, LOADER_DEPTH, LOADER_WIDTH);
+            map.add_box(WALL_MAX - LOADER_DEPTH / 2.0, row, LOADER_DEPTH, LOADER_WIDTH);
+            map.add_box(CENTER, CENTER, CENTER_GOAL_LENGTH, CENTER_GOAL_WIDTH, side * M_PI / 4.0);
+        }
+        return map;
+    }
+
+    void use_field_ranges(const FieldRangeTable* table) {
+        field_ranges = table;
+    }
+
+    double expected_range(const EVec<3>& xhat, double angle_deg) {
+        double robot_x = xhat(0);
+        double robot_y = xhat(1);
+        double robot_theta = xhat(2);
+        
+        // transofrm lidar position to field
+        double cos_theta = std::cos(robot_theta);
+        double sin_theta = std::sin(robot_theta);
+        double lidar_x = robot_x + LIDAR_OFFSET_X * cos_theta - LIDAR_OFFSET_Y * sin_theta;
+        double lidar_y = robot_y + LIDAR_OFFSET_X * sin_theta + LIDAR_OFFSET_Y * cos_theta;
+        
+        // direction in field frame
+        double beam_theta = robot_theta + LIDAR_OFFSET_ANGLE + angle_deg * M_PI / 180.0;
+        
+        if (field_ranges != nullptr && field_ranges->contains(lidar_x, lidar_y)) {
+            return field_ranges->range(lidar_x, lidar_y, beam_theta);
+        }
+
+        double c = std::cos(beam_theta);
+        double s = std::sin(beam_theta);
+        
+        double d_left = (c < 0) ? ((lidar_x - WALL_MIN) / -c) : 1e9;
+        double d_right = (c > 0) ? ((WALL_MAX - lidar_x) / c) : 1e9;
+        double d_bottom = (s < 0) ? ((lidar_y - WALL_MIN) / -s) : 1e9;
+        double d_top = (s > 0) ? ((WALL_MAX - lidar_y) / s) : 1e9;
+        
+        return std::min({d_left, d_right, d_bottom, d_top});
+    }
+
+    EVec<2> measurement(const EVec<3>& xhat, const EVec<3>& u) {
+        return EVec<2>{expected_range(xhat, u(1)), u(1)};
+    }
+
+    // Rows past count are left at 0 with a measured 0, so they add nothing
+    // to the innovation or the cross covariance and get no gain
+    BatchVector measurement_batch(const EVec<3>& xhat, const BatchVector& angles, int count) {
+        BatchVector y = BatchVector::Zero();
+        for (int i = 0; i < count; i++) {
+            y(i) = expected_range(xhat, angles(i));
+        }
+        return y;
+    }
+    
+    EVec<3> mean_state(const EMat<3, 5>& sigmas, const EVec<5>& Wm) {
+        EVec<3> x = EVec<3>::Zero();
+        double c = 0, s = 0;
+        
+        for (int i = 0; i < 5; i++) {
+            x(0) += sigmas(0, i) * Wm(i);
+            x(1) += sigmas(1, i) * Wm(i);
+            c += std::cos(sigmas(2, i)) * Wm(i);
+            s += std::sin(sigmas(2, i)) * Wm(i);
+        }
+        x(2) = std::atan2(s, c);
+        return x;
+    }
+    
+    EVec<2> mean_meas(const EMat<2, 5>& sigmas, const EVec<5>& Wm) {
+        EVec<2> y = EVec<2>::Zero();
+        double c = 0, s = 0;
+        
+        for (int i = 0; i < 5; i++) {
+            y(0) += sigmas(0, i) * Wm(i);
+            c += std::cos(sigmas(1, i) * M_PI / 180.0) * Wm(i);
+            s += std::sin(sigmas(1, i) * M_PI / 180.0) * Wm(i);
+        }
+        y(1) = std::atan2(s, c) * 180.0 / M_PI;
+        return y;
+    }
+    
+    EVec<3> residual_state(const EVec<3>& a, const EVec<3>& b) {
+        return EVec<3>{a(0) - b(0), a(1) - b(1), wrap_radians(a(2) - b(2))};
+    }
+    
+    EVec<2> residual_meas(const EVec<2>& a, const EVec<2>& b) {
+        double angle_diff = a(1) - b(1);
+        while (angle_diff > 180.0) angle_diff -= 360.0;
+        while (angle_diff < -180.0) angle_diff += 360.0;
+        return EVec<2>{a(0) - b(0), angle_diff};
+    }
+    
+    EVec<3> add_state(const EVec<3>& a, const EVec<3>& b) {
+        return EVec<3>{a(0) + b(0), a(1) + b(1), wrap_radians(a(2) + b(2))};
+    }
+    
+    UnscentedKalmanFilter<3, 3, 2> createUKF() {
+        EVec<3> state_stddevs{2.0, 2.0, 0.01};
+        
+        EVec<2> measurement_stddevs{RANGE_STDDEV, 20};
+        
+        return UnscentedKalmanFilter<3, 3, 2>(
+            dynamics, measurement, RK2_with_input<3, 3>,
+            state_stddevs, measurement_stddevs,
+            mean_state, mean_meas,
+            residual_state, residual_meas, add_state
+        );
+    }
+
+    void correct_batch(UnscentedKalmanFilter<3, 3, 2>& ukf, const BatchVector& ranges, const BatchVector& angles, int count) {
+        BatchVector y = BatchVector::Zero();
+        y.head(count) = ranges.head(count);
+
+        ukf.correct<LIDAR_MAX_BATCH>(
+            EVec<3>::Zero(), y,
+            [&angles, count](const EVec<3>& x, const EVec<3>&) { return measurement_batch(x, angles, count); },
+            BatchVector::Constant(RANGE_STDDEV),
+            [](const EMat<LIDAR_MAX_BATCH, 5>& sigmas, const EVec<5>& Wm) -> BatchVector { return sigmas * Wm; },
+            [](const BatchVector& a, const BatchVector& b) -> BatchVector { return a - b; },
+            residual_state, add_state);
+    }
+}
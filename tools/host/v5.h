@@ -0,0 +1,17 @@
+#pragma once
+
+// Just enough of the V5 SDK for the host tools in tools/ to link robot code
+// that only uses the system clock. Not part of the robot build.
+
+#include <chrono>
+#include <stdint.h>
+#include <thread>
+
+inline uint64_t vexSystemHighResTimeGet() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline uint32_t vexSystemTimeGet() { return (uint32_t)(vexSystemHighResTimeGet() / 1000); }
+
+inline void vexDelay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
@@ -0,0 +1,27 @@
+#pragma once
+
+// Host stand ins for the vex:: classes the tools in tools/ pull in. There is
+// no SD card, so anything that caches to it rebuilds every run.
+
+#include <stdint.h>
+#include <thread>
+
+namespace vex {
+
+class brain {
+  public:
+    class sdcard {
+      public:
+        bool isInserted() { return false; }
+        bool exists(const char *) { return false; }
+        int32_t size(const char *) { return 0; }
+        int32_t loadfile(const char *, uint8_t *, int32_t) { return 0; }
+        int32_t savefile(const char *, uint8_t *, int32_t) { return 0; }
+    };
+};
+
+namespace this_thread {
+inline void yield() { std::this_thread::yield(); }
+} // namespace this_thread
+
+} // namespace vex
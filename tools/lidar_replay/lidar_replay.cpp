@@ -0,0 +1,200 @@
+// Replays a simulated match through the lidar UKF, once with a predict and
+// correct per beam and once per batch setting, and prints the CPU time spent
+// in the filter next to the pose error. Uses the same lidar_ukf code the
+// robot runs (src/subsystems/LidarUKF.cpp), driven the way lidar_thread
+// drives it: a predict at least every 10 ms, beams gated by BEAM_TOLERANCE,
+// and a batch applied once it is full or its first beam is max latency old.
+//
+// Build and run from the repo root (see tools/README.md):
+//
+//   g++ -std=gnu++17 -O2 -Itools/host -Iinclude -Icore/include -Ivendor/eigen \
+//     tools/lidar_replay/lidar_replay.cpp src/subsystems/LidarUKF.cpp src/subsystems/FieldMap.cpp \
+//     -o lidar_replay
+//   ./lidar_replay [--field-map] [batch sizes...]
+//
+// With no sizes it runs per beam and batches of 4, 8 and 16. --field-map
+// measures against the field element table instead of the bare walls.
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "subsystems/LidarUKF.h"
+
+namespace {
+
+// lidar_thread's defaults
+constexpr double BEAM_TOLERANCE = 10;
+constexpr double PREDICT_PERIOD_S = 0.01;
+constexpr double BATCH_LATENCY_S = 0.02;
+
+// sensor and run
+constexpr double BEAM_HZ = 5000;
+constexpr double SPIN_HZ = 10;
+constexpr double RUN_S = 30;
+constexpr double SETTLE_S = 2;
+constexpr double RANGE_NOISE_IN = 0.5;
+constexpr double WHEEL_NOISE_INPS = 0.5;
+constexpr double GYRO_NOISE_RADPS = 0.02;
+
+struct Result {
+    double filter_us_per_beam;
+    double mean_error_in;
+    double max_error_in;
+    double mean_heading_error_deg;
+    int beams;
+    int corrects;
+};
+
+// Drives a loop around the middle of the field
+EVec<3> true_input(double t) { return EVec<3>{25.0 * std::sin(0.7 * t), 0.0, 1.2 * std::sin(0.45 * t)}; }
+
+double wrap_degrees(double angle) {
+    while (angle > 180) angle -= 360;
+    while (angle < -180) angle += 360;
+    return angle;
+}
+
+/**
+ * @param batch_size 0 for a predict and correct per beam
+ */
+Result replay(int batch_size) {
+    // same seed every run so every mode sees the same beams and noise
+    std::mt19937 rng(1);
+    std::normal_distribution<double> range_noise(0, RANGE_NOISE_IN);
+    std::normal_distribution<double> wheel_noise(0, WHEEL_NOISE_INPS);
+    std::normal_distribution<double> gyro_noise(0, GYRO_NOISE_RADPS);
+
+    UnscentedKalmanFilter<3, 3, 2> ukf = lidar_ukf::createUKF();
+    EVec<3> truth{72, 72, 0.3};
+    ukf.set_xhat(EVec<3>{75, 69, 0.32});
+    ukf.set_P(EMat<3, 3>{{2, 0, 0}, {0, 2, 0}, {0, 0, 0.00025}});
+
+    lidar_ukf::BatchVector ranges = lidar_ukf::BatchVector::Zero();
+    lidar_ukf::BatchVector angles = lidar_ukf::BatchVector::Zero();
+    int batch_count = 0;
+    double batch_start = 0;
+    double last_predict = 0;
+
+    Result result = {};
+    double error_sum = 0, heading_sum = 0;
+    int error_count = 0;
+    std::chrono::steady_clock::duration filter_time = std::chrono::steady_clock::duration::zero();
+
+    const double dt = 1.0 / BEAM_HZ;
+    const int steps = (int)(RUN_S * BEAM_HZ);
+    for (int i = 1; i <= steps; i++) {
+        const double t = i * dt;
+        truth += lidar_ukf::dynamics(truth, true_input(t)) * dt;
+        // what get_robot_velocity would read
+        const EVec<3> true_u = true_input(t);
+        const EVec<3> u{true_u(0) + wheel_noise(rng), 0.0, true_u(2) + gyro_noise(rng)};
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        auto predict_to = [&](double now) {
+            if (now > last_predict) {
+                ukf.predict(u, now - last_predict);
+                last_predict = now;
+            }
+        };
+        auto flush = [&]() {
+            predict_to(t);
+            lidar_ukf::correct_batch(ukf, ranges, angles, batch_count);
+            batch_count = 0;
+            result.corrects++;
+        };
+
+        if (t - last_predict >= PREDICT_PERIOD_S) {
+            predict_to(t);
+        }
+        if (batch_count > 0 && t - batch_start >= BATCH_LATENCY_S) {
+            flush();
+        }
+
+        // the sensor sweeps continuously, beams pointing into the robot are dropped like lidar_thread does
+        const double angle = std::fmod(t * SPIN_HZ * 360.0, 360.0);
+        if (!(angle > 5 && angle < 200)) {
+            const double distance = lidar_ukf::expected_range(truth, angle) + range_noise(rng);
+            if (std::abs(distance - lidar_ukf::expected_range(ukf.xhat(), angle)) <= BEAM_TOLERANCE) {
+                result.beams++;
+                if (batch_size == 0) {
+                    predict_to(t);
+                    ukf.correct(EVec<3>{0.0, angle, 0.0}, EVec<2>{distance, angle});
+                    result.corrects++;
+                } else {
+                    if (batch_count == 0) {
+                        batch_start = t;
+                    }
+                    ranges(batch_count) = distance;
+                    angles(batch_count) = angle;
+                    batch_count++;
+                    if (batch_count >= batch_size) {
+                        flush();
+                    }
+                }
+            }
+        }
+        filter_time += std::chrono::steady_clock::now() - start;
+
+        if (t >= SETTLE_S) {
+            const double error = std::hypot(ukf.xhat(0) - truth(0), ukf.xhat(1) - truth(1));
+            error_sum += error;
+            heading_sum += std::abs(wrap_degrees((ukf.xhat(2) - truth(2)) * 180.0 / M_PI));
+            error_count++;
+            if (error > result.max_error_in) {
+                result.max_error_in = error;
+            }
+        }
+    }
+
+    result.filter_us_per_beam =
+      std::chrono::duration<double, std::micro>(filter_time).count() / (result.beams > 0 ? result.beams : 1);
+    result.mean_error_in = error_sum / error_count;
+    result.mean_heading_error_deg = heading_sum / error_count;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    FieldRangeTable table(FIELD_SIZE);
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--field-map") == 0) {
+            table.build(lidar_ukf::field_map());
+            lidar_ukf::use_field_ranges(&table);
+        } else {
+            const int size = atoi(argv[i]);
+            if (size < 1 || size > LIDAR_MAX_BATCH) {
+                printf("batch sizes go from 1 to %d\n", LIDAR_MAX_BATCH);
+                return 1;
+            }
+            sizes.push_back(size);
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {4, 8, 16};
+    }
+    sizes.insert(sizes.begin(), 0);
+
+    printf("%.0f s at %.0f beams/s, %.1f in range noise, batch latency %.0f ms\n", RUN_S, BEAM_HZ, RANGE_NOISE_IN,
+           BATCH_LATENCY_S * 1000);
+    printf("%-10s %8s %10s %10s %12s %12s %12s\n", "mode", "beams", "corrects", "us/beam", "mean err in",
+           "max err in", "heading deg");
+    for (int size : sizes) {
+        const Result r = replay(size);
+        char mode[16];
+        if (size == 0) {
+            snprintf(mode, sizeof(mode), "per beam");
+        } else {
+            snprintf(mode, sizeof(mode), "batch %d", size);
+        }
+        printf("%-10s %8d %10d %10.2f %12.3f %12.3f %12.3f\n", mode, r.beams, r.corrects, r.filter_us_per_beam,
+               r.mean_error_in, r.max_error_in, r.mean_heading_error_deg);
+    }
+    return 0;
+}
@@ -0,0 +1,211 @@
+// Host microbenchmark of VDB channel serialization: time and heap allocations
+// per packet for channels laid out like MotorDataRecord (5 Floats) and
+// OdometryDataRecord (3 Floats). The real records read a vex::motor and an
+// OdometryBase in fetch(), which don't exist on a desktop, so the benchmark
+// builds Records with the same fields and sets their values itself. Writing
+// and reading go through the real PacketWriter, PacketReader and Part code.
+//
+// Build and run from the repo root (see tools/README.md):
+//
+//   g++ -std=gnu++17 -O2 -Icore/include tools/vdb_bench/vdb_bench.cpp \
+//     core/src/device/vdb/protocol.cpp core/src/device/vdb/types.cpp \
+//     core/src/device/vdb/crc32.cpp core/src/device/vdb/visitor.cpp -o vdb_bench
+//   ./vdb_bench [packets]
+//
+// To compare against an older tree, check it out (e.g. with git worktree) and
+// build this file against it with -DVDB_BENCH_BASELINE. That keeps to the
+// PacketWriter/PacketReader calls every version has, so only the Part tree
+// write, the send path and the read are measured.
+
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdio.h>
+#include <vector>
+
+#include "core/device/vdb/protocol.hpp"
+#include "core/device/vdb/types.hpp"
+
+namespace {
+long allocations = 0;
+} // namespace
+
+void *operator new(size_t size) {
+    allocations++;
+    void *ptr = malloc(size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+
+// protocol.hpp declares these for the device side, nothing benchmarked here calls them
+namespace VDB {
+uint32_t time_ms() { return 0; }
+void delay_ms(uint32_t) {}
+} // namespace VDB
+
+using namespace VDP;
+
+namespace {
+
+struct TestRecord {
+    PartPtr record;
+    std::vector<std::shared_ptr<Float>> fields;
+};
+
+TestRecord make_record(const char *name, const std::vector<const char *> &field_names) {
+    TestRecord out;
+    std::vector<PartPtr> parts;
+    for (const char *field : field_names) {
+        out.fields.push_back(std::make_shared<Float>(field));
+        parts.push_back(out.fields.back());
+    }
+    out.record = PartPtr(new Record(name, parts));
+    return out;
+}
+
+// What fetch() does every send, new values so delta packets have something to send
+void update(TestRecord &rec, int i) {
+    for (size_t f = 0; f < rec.fields.size(); f++) {
+        rec.fields[f]->set_value((float)(i * 0.25 + f));
+    }
+}
+
+struct Measurement {
+    double ns_per_packet;
+    double allocations_per_packet;
+    double bytes_per_packet;
+};
+
+template <typename BODY> Measurement measure(int packets, BODY body) {
+    // one untimed pass so scratch packets have grown to size
+    body(0);
+    size_t bytes = 0;
+    const long start_allocations = allocations;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < packets; i++) {
+        bytes += body(i);
+    }
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    Measurement m;
+    m.ns_per_packet = std::chrono::duration<double, std::nano>(end - start).count() / packets;
+    m.allocations_per_packet = (double)(allocations - start_allocations) / packets;
+    m.bytes_per_packet = (double)bytes / packets;
+    return m;
+}
+
+void report(const char *name, const Measurement &m) {
+    printf("%-32s %9.1f %12.2f %8.1f\n", name, m.ns_per_packet, m.allocations_per_packet, m.bytes_per_packet);
+}
+
+bool round_trip(TestRecord &from, TestRecord &to, Channel &chan) {
+    update(from, 7);
+    Packet pac;
+    PacketWriter writ{pac};
+    writ.write_data_message(chan);
+    // header and channel id come before the data
+    PacketReader reader{pac, 2};
+    to.record->read_data_from_message(reader);
+    for (size_t f = 0; f < from.fields.size(); f++) {
+        if (from.fields[f]->get_value() != to.fields[f]->get_value()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const int packets = argc > 1 ? atoi(argv[1]) : 1000000;
+    if (packets < 1) {
+        printf("usage: %s [packets]\n", argv[0]);
+        return 1;
+    }
+
+    const std::vector<const char *> motor_fields = {
+      "Position(deg)", "velocity(dps)", "Temperature(C)", "Voltage(V)", "Current(%)"
+    };
+    const std::vector<const char *> odometry_fields = {"X", "Y", "Rotation"};
+
+    TestRecord motor = make_record("motor", motor_fields);
+    TestRecord odometry = make_record("odometry", odometry_fields);
+    TestRecord motor_in = make_record("motor", motor_fields);
+    Channel motor_chan(motor.record);
+    Channel odometry_chan(odometry.record);
+
+    if (!round_trip(motor, motor_in, motor_chan)) {
+        printf("!! motor record did not survive a write and read !!\n");
+        return 1;
+    }
+
+    printf("%d packets each, alternating motor and odometry channels\n", packets);
+    printf("%-32s %9s %12s %8s\n", "", "ns/packet", "allocs/packet", "bytes");
+
+    // what a send used to cost when every send built a new packet and copied it for the device
+    report("send, new packet each time", measure(packets, [&](int i) {
+               TestRecord &rec = i & 1 ? motor : odometry;
+               update(rec, i);
+               Packet fresh;
+               PacketWriter writ{fresh};
+               writ.write_data_message(i & 1 ? motor_chan : odometry_chan);
+               Packet sent = writ.get_packet();
+               return sent.size();
+           }));
+
+    Packet scratch;
+    report("write, Part tree", measure(packets, [&](int i) {
+               TestRecord &rec = i & 1 ? motor : odometry;
+               update(rec, i);
+               PacketWriter writ{scratch};
+               writ.write_data_message(i & 1 ? motor_chan : odometry_chan);
+               return writ.size();
+           }));
+
+#ifndef VDB_BENCH_BASELINE
+    motor_chan.compile_layout();
+    odometry_chan.compile_layout();
+    report("write, compiled layout", measure(packets, [&](int i) {
+               TestRecord &rec = i & 1 ? motor : odometry;
+               update(rec, i);
+               PacketWriter writ{scratch};
+               writ.write_data_message(i & 1 ? motor_chan : odometry_chan);
+               return writ.size();
+           }));
+
+    uint8_t buffer[64];
+    report("write, fixed buffer", measure(packets, [&](int i) {
+               TestRecord &rec = i & 1 ? motor : odometry;
+               update(rec, i);
+               PacketWriter writ{buffer, sizeof(buffer)};
+               writ.write_data_message(i & 1 ? motor_chan : odometry_chan);
+               return writ.overflowed() ? (size_t)0 : writ.size();
+           }));
+
+    report("write, delta (keyframe every 25)", measure(packets, [&](int i) {
+               TestRecord &rec = i & 1 ? motor : odometry;
+               // only one field moves, like a motor holding still
+               rec.fields[0]->set_value((float)i);
+               PacketWriter writ{scratch};
+               writ.write_delta_message(i & 1 ? motor_chan : odometry_chan, 25);
+               return writ.size();
+           }));
+#endif
+
+    Packet motor_packet;
+    {
+        PacketWriter writ{motor_packet};
+        writ.write_data_message(motor_chan);
+    }
+    report("read motor record", measure(packets, [&](int) {
+               PacketReader reader{motor_packet, 2};
+               motor_in.record->read_data_from_message(reader);
+               return motor_packet.size();
+           }));
+
+    return 0;
+}